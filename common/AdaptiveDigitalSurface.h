@@ -0,0 +1,280 @@
+#pragma once
+
+#include <string>
+#include <sstream>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+
+#include "DGtal/base/Common.h"
+#include "DGtal/helpers/StdDefs.h"
+#include "DGtal/helpers/Shortcuts.h"
+
+#include "common/Parallel.h"
+#include "common/SurfelStream.h"
+#include "common/ParallelSurfelExtraction.h"
+#include "common/ConnectedComponents.h"
+
+/// Digital surface whose container, light (LightImplicitDigitalSurface)
+/// or explicit (SetOfSurfels), is chosen from estimated costs. The choice
+/// only changes the container, never the surfels.
+///
+/// The surface is first fixed from the components of voxels (see
+/// ConnectedComponents, 6/18 for the default interior surfel adjacency):
+/// - "surfaceComponents" "AnyBig": the outer boundary of the biggest
+///   foreground component, i.e. the surfels between this component and
+///   the background component of the voxel before its first voxel.
+/// - otherwise, all boundary surfels. The light container only holds
+///   them if they form a single surface, i.e. if there is a single
+///   foreground and a single background component.
+///
+/// The light container tracks the surface from a bel of the first voxel
+/// of the component, and its cost is a tracking per traversal. The
+/// explicit one scans the whole image by slabs (ParallelSurfelExtraction),
+/// keeps the surfels of the component (ConnectedComponents::labelSurfels)
+/// and inserts them into a set, and its cost is then an iteration over
+/// the set per traversal. So the light container wins on big volumes with
+/// small surfaces, the explicit one when the surface fills the volume or
+/// is traversed many times.
+///
+/// The costs are estimated from a sample: a few planes of the image are
+/// scanned, giving the scan time per voxel, the occupancy and the number
+/// of surfels of the surface, then a few thousand surfels are tracked
+/// (by iterating the light container, visited set included, as any
+/// traversal does), inserted into a set and iterated over.
+///
+/// Parameters: "surfaceComponents", "surfelAdjacency", "surfaceContainer"
+/// ("Auto", "Light" or "Explicit") and "surfaceTraversals" (the expected
+/// number of traversals of the surface, e.g. 1 for a single surfels()).
+
+typedef DGtal::Shortcuts<DGtal::Z3i::KSpace> ADSH3;
+
+/// A digital surface built by makeAdaptiveDigitalSurface.
+struct AdaptiveDigitalSurface
+{
+  enum Container { Light, Explicit };
+
+  Container                                   container = Explicit;
+  DGtal::CountedPtr<ADSH3::LightDigitalSurface> lightSurface;    ///< if Light
+  DGtal::CountedPtr<ADSH3::DigitalSurface>      explicitSurface; ///< if Explicit
+  ADSH3::KSpace space;                  ///< the Khalimsky space of the surfels
+  std::size_t nbVoxels           = 0;   ///< scanned by the explicit container
+  double      occupancy          = 0.0; ///< estimated fraction of foreground voxels
+  double      estimatedSurfels   = 0.0; ///< estimated number of boundary surfels
+  double      estimatedSurface   = 0.0; ///< estimated number of surfels of the surface
+  double      lightCost          = 0.0; ///< estimated, in ms
+  double      explicitCost       = 0.0; ///< estimated, in ms
+  double      labelTime          = 0.0; ///< in ms
+  double      sampleTime         = 0.0; ///< in ms
+  double      buildTime          = 0.0; ///< in ms
+  std::string reason;                   ///< why the container was chosen
+
+  /// @return "light" or "explicit".
+  std::string containerName() const
+  {
+    return container == Light ? "light" : "explicit";
+  }
+
+  /// @return the surfels of the surface in scan order (z, y, then x of
+  /// their Khalimsky coordinates), whatever the container.
+  ADSH3::SurfelRange surfels() const
+  {
+    ADSH3::SurfelRange result;
+    if ( container == Light && lightSurface )
+      result.assign( lightSurface->begin(), lightSurface->end() );
+    else if ( container == Explicit && explicitSurface )
+      result.assign( explicitSurface->begin(), explicitSurface->end() );
+    const ADSH3::KSpace& K = space;
+    std::sort( result.begin(), result.end(),
+               [&K] ( const ADSH3::SCell& a, const ADSH3::SCell& b )
+               {
+                 const auto p = K.sKCoords( a );
+                 const auto q = K.sKCoords( b );
+                 if ( p[ 2 ] != q[ 2 ] ) return p[ 2 ] < q[ 2 ];
+                 if ( p[ 1 ] != q[ 1 ] ) return p[ 1 ] < q[ 1 ];
+                 return p[ 0 ] < q[ 0 ];
+               } );
+    return result;
+  }
+};
+
+/// @return the parameters of makeAdaptiveDigitalSurface.
+inline DGtal::Parameters parametersAdaptiveDigitalSurface()
+{
+  return DGtal::Parameters( "surfaceContainer", "Auto" )( "surfaceTraversals", 1 );
+}
+
+/// Builds the digital surface of \a bimage with the cheaper container
+/// and logs the choice, the estimates and the timings.
+///
+/// @param nbSampledPlanes the number of planes scanned in the sample.
+/// @param nbTrackedSurfels the number of surfels tracked in the sample.
+/// @param nbThreads the number of threads (0 means all cores).
+inline AdaptiveDigitalSurface
+makeAdaptiveDigitalSurface( DGtal::CountedPtr<ADSH3::BinaryImage> bimage,
+                            const ADSH3::KSpace& K,
+                            const DGtal::Parameters& params,
+                            std::size_t nbSampledPlanes = 8,
+                            std::size_t nbTrackedSurfels = 4096,
+                            unsigned int nbThreads = 0 )
+{
+  using namespace DGtal;
+  typedef ADSH3::KSpace::Point Point;
+  typedef ADSH3::SCell         SCell;
+  typedef std::chrono::steady_clock Clock;
+  auto ms = [] ( Clock::time_point a, Clock::time_point b )
+    { return std::chrono::duration<double, std::milli>( b - a ).count(); };
+
+  AdaptiveDigitalSurface S;
+  S.space = K;
+  const Parameters   all        = ADSH3::parametersDigitalSurface()
+    | parametersAdaptiveDigitalSurface() | params;
+  const std::string  forced     = all[ "surfaceContainer" ].as<std::string>();
+  const bool         anyBig     = all[ "surfaceComponents" ].as<std::string>() == "AnyBig";
+  const double       traversals = std::max( 1, all[ "surfaceTraversals" ].as<int>() );
+  const int          adjacency  = all[ "surfelAdjacency" ].as<int>() == 0 ? 6 : 18;
+  SurfelAdjacency<ADSH3::KSpace::dimension> surfAdj( all[ "surfelAdjacency" ].as<int>() );
+  if ( nbThreads == 0 ) nbThreads = defaultNumberOfThreads();
+
+  // The surface, whatever the container: its foreground (inner) and
+  // background (outer) components, and a bel between them.
+  auto t0 = Clock::now();
+  ConnectedComponents components( *bimage, adjacency, nbThreads );
+  std::size_t nbForeground = 0;
+  for ( const auto& C : components.components() ) nbForeground += C.foreground ? 1 : 0;
+  const std::size_t nbBackground = components.nbComponents() - nbForeground;
+  const std::size_t inner  = components.biggest( true );
+  const bool        empty  = inner == components.nbComponents();
+  const bool        single = anyBig || ( nbForeground == 1 && nbBackground == 1 );
+  std::size_t outer = components.outside();
+  SCell       bel;
+  if ( ! empty )
+    {
+      const Point p = components.components()[ inner ].first;
+      outer = components.label( p - Point( 1, 0, 0 ) );
+      Point c = p * 2 + Point::diagonal( 1 );
+      c[ 0 ] -= 1;
+      bel = K.sCell( c, K.POS );
+      if ( K.sCoords( K.sDirectIncident( bel, 0 ) ) != p ) bel = K.sOpp( bel );
+    }
+  auto t1 = Clock::now();
+  S.labelTime = ms( t0, t1 );
+
+  // Sample of planes: scan time, occupancy and number of surfels.
+  typedef SurfelStream<ADSH3::KSpace, ADSH3::BinaryImage> Stream;
+  const Stream stream( K, *bimage );
+  const Point  lo = bimage->domain().lowerBound();
+  const Point  hi = bimage->domain().upperBound();
+  const std::size_t nbPlanes  = std::size_t( stream.lastPlane() - stream.firstPlane() + 1 );
+  const std::size_t planeSize = std::size_t( hi[ 0 ] - lo[ 0 ] + 2 ) * std::size_t( hi[ 1 ] - lo[ 1 ] + 2 );
+  const std::size_t nbSamples = std::max( std::size_t( 1 ), std::min( nbSampledPlanes, nbPlanes ) );
+  S.nbVoxels = nbPlanes * planeSize;
+  double scanTime = 0.0, selectTime = 0.0;
+  std::size_t nbSurfels = 0, nbSurface = 0, nbInside = 0, nbVoxels = 0;
+  ADSH3::SurfelRange plane;
+  for ( std::size_t i = 0; i < nbSamples; ++i )
+    {
+      const int z = stream.firstPlane() + int( ( 2 * i + 1 ) * nbPlanes / ( 2 * nbSamples ) );
+      plane.clear();
+      auto a = Clock::now();
+      stream.extract( z, z + 1, plane );
+      auto b = Clock::now();
+      for ( const auto& s : plane )
+        {
+          const auto k = K.sOrthDir( s );
+          nbSurface += components.label( K.sCoords( K.sDirectIncident( s, k ) ) ) == inner
+            && components.label( K.sCoords( K.sIndirectIncident( s, k ) ) ) == outer;
+        }
+      auto c = Clock::now();
+      scanTime   += ms( a, b );
+      selectTime += ms( b, c );
+      nbSurfels  += plane.size();
+      if ( z <= hi[ 2 ] )
+        for ( int y = lo[ 1 ]; y <= hi[ 1 ]; ++y )
+          for ( int x = lo[ 0 ]; x <= hi[ 0 ]; ++x, ++nbVoxels )
+            nbInside += ( *bimage )( Point( x, y, z ) ) ? 1 : 0;
+    }
+  const double scale = double( nbPlanes ) / double( nbSamples );
+  S.occupancy        = nbVoxels > 0 ? double( nbInside ) / double( nbVoxels ) : 0.0;
+  S.estimatedSurfels = scale * nbSurfels;
+  S.estimatedSurface = anyBig ? scale * nbSurface : S.estimatedSurfels;
+  auto t2 = Clock::now();
+
+  S.container = AdaptiveDigitalSurface::Explicit;
+  if ( empty )
+    S.reason = "no surface";
+  else if ( ! single )
+    S.reason = "several surfaces, that only the explicit container holds";
+  else if ( forced == "Light" || forced == "Explicit" )
+    {
+      S.container = forced == "Light"
+        ? AdaptiveDigitalSurface::Light : AdaptiveDigitalSurface::Explicit;
+      S.reason    = "surfaceContainer is " + forced;
+    }
+  else
+    {
+      // Unit costs of tracking, inserting into a set and iterating.
+      ADSH3::LightDigitalSurface light( new ADSH3::LightSurfaceContainer( K, *bimage, surfAdj, bel ) );
+      ADSH3::SurfelRange sample;
+      auto a = Clock::now();
+      for ( auto it = light.begin(), ite = light.end();
+            it != ite && sample.size() < nbTrackedSurfels; ++it )
+        sample.push_back( *it );
+      auto b = Clock::now();
+      ADSH3::SurfelSet set( sample.begin(), sample.end() );
+      auto c = Clock::now();
+      std::size_t nb = 0;
+      for ( const auto& s : set ) nb += K.sOrthDir( s ) < 3;
+      auto d = Clock::now();
+      const double n       = double( std::max( std::size_t( 1 ), sample.size() ) );
+      const double track   = ms( a, b ) / n;
+      const double insert  = ms( b, c ) / n;
+      const double iterate = ms( c, d ) / double( std::max( std::size_t( 1 ), nb ) );
+      const double scan    = scanTime / double( nbSamples * planeSize );
+      const double select  = anyBig ? selectTime / double( std::max( std::size_t( 1 ), nbSurfels ) ) : 0.0;
+      S.lightCost    = traversals * track * S.estimatedSurface;
+      S.explicitCost = scan * double( S.nbVoxels ) / double( nbThreads )
+        + select * S.estimatedSurfels
+        + ( insert + traversals * iterate ) * S.estimatedSurface;
+      S.container    = S.lightCost <= S.explicitCost
+        ? AdaptiveDigitalSurface::Light : AdaptiveDigitalSurface::Explicit;
+      S.reason       = "estimated cost";
+    }
+  auto t3 = Clock::now();
+  S.sampleTime = ms( t1, t3 );
+
+  if ( ! empty && S.container == AdaptiveDigitalSurface::Light )
+    S.lightSurface = CountedPtr<ADSH3::LightDigitalSurface>
+      ( new ADSH3::LightDigitalSurface( new ADSH3::LightSurfaceContainer( K, *bimage, surfAdj, bel ) ) );
+  else if ( ! empty )
+    {
+      ParallelSurfelExtraction<ADSH3::KSpace, ADSH3::BinaryImage> extraction( K, *bimage, nbThreads );
+      auto surfels = extraction.surfels();
+      if ( anyBig )
+        {
+          const auto SC = components.labelSurfels( K, surfels, nbThreads );
+          std::size_t c = 0;
+          while ( c < SC.components.size()
+                  && ( SC.components[ c ].inner != inner || SC.components[ c ].outer != outer ) )
+            ++c;
+          surfels = SC.select( surfels, c );
+        }
+      ADSH3::SurfelSet set( surfels.begin(), surfels.end() );
+      S.explicitSurface = CountedPtr<ADSH3::DigitalSurface>
+        ( new ADSH3::DigitalSurface( new ADSH3::ExplicitSurfaceContainer( K, surfAdj, set ) ) );
+    }
+  S.buildTime = ms( t3, Clock::now() );
+
+  std::ostringstream log;
+  log << "[makeAdaptiveDigitalSurface] " << S.containerName()
+      << " container (" << S.reason << "), " << S.nbVoxels << " voxels, occupancy "
+      << S.occupancy << ", about " << std::size_t( S.estimatedSurface ) << " / "
+      << std::size_t( S.estimatedSurfels ) << " surfels";
+  if ( S.lightCost > 0.0 || S.explicitCost > 0.0 )
+    log << ", estimated light " << S.lightCost << " / explicit " << S.explicitCost << " ms";
+  log << ", labelling " << S.labelTime << " ms, sample " << S.sampleTime
+      << " ms, build " << S.buildTime << " ms";
+  trace.info() << log.str() << std::endl;
+  return S;
+}
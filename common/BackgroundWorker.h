@@ -0,0 +1,181 @@
+#pragma once
+
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <exception>
+#include <stdexcept>
+
+/// Runs tasks one at a time on a worker thread, so that a GUI stays
+/// interactive while they compute.
+///
+/// Submitting a task supersedes the pending one and asks the running one
+/// to stop: tasks call Token::check() between their steps, which throws
+/// when they have been superseded. Only the result of the latest task is
+/// kept; the GUI thread polls it with take() and swaps it into the viewer.
+///
+/// @tparam TResult the type of the result of a task.
+template <typename TResult>
+class BackgroundWorker
+{
+public:
+  typedef TResult Result;
+
+  /// Thrown by Token::check() when the task has been superseded.
+  struct Cancelled {};
+
+  /// Given to a task to report progress and check for cancellation.
+  class Token
+  {
+  public:
+    Token( BackgroundWorker& worker, unsigned long generation )
+      : myWorker( worker ), myGeneration( generation ) {}
+    /// @return 'true' if a newer task has been submitted.
+    bool cancelled() const { return myWorker.myGeneration != myGeneration; }
+    /// Throws Cancelled if a newer task has been submitted. Thread-safe,
+    /// so that the chunks of a parallel loop may call it.
+    void check() const { if ( cancelled() ) throw Cancelled(); }
+    /// Reports that the task enters \a stage, at \a fraction of its work,
+    /// and checks for cancellation.
+    void progress( const std::string& stage, double fraction ) const
+    {
+      check();
+      std::lock_guard<std::mutex> lock( myWorker.myMutex );
+      myWorker.myStage    = stage;
+      myWorker.myProgress = fraction;
+    }
+  private:
+    BackgroundWorker& myWorker;
+    unsigned long     myGeneration;
+  };
+
+  typedef std::function<Result( const Token& )> Task;
+
+  BackgroundWorker()
+    : myGeneration( 0 ), myStop( false ), myHasTask( false ),
+      myHasResult( false ), myBusy( false ), myProgress( 0.0 )
+  {
+    myThread = std::thread( &BackgroundWorker::loop, this );
+  }
+
+  ~BackgroundWorker()
+  {
+    {
+      std::lock_guard<std::mutex> lock( myMutex );
+      myStop = true;
+      ++myGeneration;
+    }
+    myCondition.notify_one();
+    myThread.join();
+  }
+
+  /// Submits \a task, superseding the pending and the running ones.
+  void submit( Task task )
+  {
+    {
+      std::lock_guard<std::mutex> lock( myMutex );
+      myTask    = task;
+      myHasTask = true;
+      ++myGeneration;
+    }
+    myCondition.notify_one();
+  }
+
+  /// Moves the result of the latest task to \a result, if it is ready.
+  /// @return 'true' if there was a new result.
+  bool take( Result& result )
+  {
+    std::lock_guard<std::mutex> lock( myMutex );
+    if ( ! myHasResult ) return false;
+    std::swap( result, myResult );
+    myHasResult = false;
+    return true;
+  }
+
+  /// @return 'true' if a task is pending or running.
+  bool busy() const
+  {
+    std::lock_guard<std::mutex> lock( myMutex );
+    return myHasTask || myBusy;
+  }
+
+  /// @return the stage of the running task.
+  std::string stage() const
+  {
+    std::lock_guard<std::mutex> lock( myMutex );
+    return myStage;
+  }
+
+  /// @return the progress (between 0 and 1) of the running task.
+  double progress() const
+  {
+    std::lock_guard<std::mutex> lock( myMutex );
+    return myProgress;
+  }
+
+  /// @return the error message of the last failed task (empty if none).
+  std::string error() const
+  {
+    std::lock_guard<std::mutex> lock( myMutex );
+    return myError;
+  }
+
+protected:
+  std::thread                 myThread;
+  mutable std::mutex          myMutex;
+  std::condition_variable     myCondition;
+  std::atomic<unsigned long>  myGeneration;
+  bool                        myStop;
+  bool                        myHasTask;
+  bool                        myHasResult;
+  bool                        myBusy;
+  Task                        myTask;
+  Result                      myResult;
+  std::string                 myStage;
+  double                      myProgress;
+  std::string                 myError;
+
+  void loop()
+  {
+    for ( ;; )
+      {
+        Task          task;
+        unsigned long generation;
+        {
+          std::unique_lock<std::mutex> lock( myMutex );
+          myCondition.wait( lock, [this] { return myStop || myHasTask; } );
+          if ( myStop ) return;
+          task       = myTask;
+          generation = myGeneration;
+          myHasTask  = false;
+          myBusy     = true;
+          myProgress = 0.0;
+          myStage.clear();
+          myError.clear();
+        }
+        Token token( *this, generation );
+        try {
+          Result result = task( token );
+          std::lock_guard<std::mutex> lock( myMutex );
+          if ( myGeneration == generation )
+            {
+              std::swap( myResult, result );
+              myHasResult = true;
+            }
+        } catch ( const Cancelled& ) {
+        } catch ( const std::exception& e ) {
+          std::lock_guard<std::mutex> lock( myMutex );
+          myError = e.what();
+        } catch ( ... ) {
+          std::lock_guard<std::mutex> lock( myMutex );
+          myError = "unknown error";
+        }
+        std::lock_guard<std::mutex> lock( myMutex );
+        myBusy     = false;
+        myProgress = 1.0;
+      }
+  }
+};
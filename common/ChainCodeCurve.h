@@ -0,0 +1,295 @@
+#pragma once
+
+#include <vector>
+#include <utility>
+#include <iterator>
+#include <cstddef>
+
+#include <DGtal/base/Common.h>
+#include <DGtal/base/Exceptions.h>
+#include <DGtal/base/Circulator.h>
+#include <DGtal/geometry/curves/GridCurve.h>
+
+/// A closed 4-connected digital curve stored as a Freeman chain code,
+/// i.e. 2 bits per step (0: +x, 1: +y, 2: -x, 3: -y).
+///
+/// Codes are packed by 32 into 64-bit words and one point is kept per word
+/// (anchor), so that any point of the curve is retrieved with at most 31
+/// steps. The memory footprint is about 0.5 byte per step, whereas a
+/// GridCurve stores one signed cell per step.
+///
+/// The curve offers the same point and incident-point ranges as GridCurve,
+/// with iterators and circulators, so that it can be given to the
+/// segment computers and estimators of DGtal in place of a GridCurve.
+///
+/// @tparam TKSpace a 2D Khalimsky space (e.g. Z2i::KSpace).
+template <typename TKSpace>
+class ChainCodeCurve
+{
+public:
+  typedef ChainCodeCurve<TKSpace>     Self;
+  typedef TKSpace                     KSpace;
+  typedef typename KSpace::Point      Point;
+  typedef typename KSpace::Vector     Vector;
+  typedef std::pair<Point,Point>      IncidentPoints;
+  typedef std::size_t                 Index;
+  typedef DGtal::uint64_t             Word;
+  typedef unsigned char               Code;
+
+  static_assert( KSpace::dimension == 2, "ChainCodeCurve is a 2D curve" );
+
+  // ----------------------- range machinery ---------------------------
+
+  /// Gives the point at index \a i.
+  struct PointFunctor
+  {
+    typedef Point Value;
+    Value operator()( const Self& /*curve*/, Index /*i*/, const Point& p ) const
+    { return p; }
+  };
+
+  /// Gives the (inner, outer) pixels of the step at index \a i.
+  struct IncidentPointsFunctor
+  {
+    typedef IncidentPoints Value;
+    Value operator()( const Self& curve, Index i, const Point& p ) const
+    { return curve.incidentPoints( p, curve.code( i ) ); }
+  };
+
+  /// Random-access iterator over the curve. The current point is kept
+  /// and updated from the codes; jumps go through the anchors.
+  template <typename TFunctor>
+  class Iterator
+  {
+  public:
+    typedef std::random_access_iterator_tag  iterator_category;
+    typedef typename TFunctor::Value         value_type;
+    typedef std::ptrdiff_t                   difference_type;
+    typedef const value_type*                pointer;
+    typedef value_type                       reference;
+
+    Iterator() : myCurve( 0 ), myIndex( 0 ) {}
+    Iterator( const Self* curve, Index i )
+      : myCurve( curve ), myIndex( i ), myPoint( curve->point( i ) ) {}
+
+    reference operator*() const
+    { return TFunctor()( *myCurve, myIndex, myPoint ); }
+    pointer operator->() const
+    {
+      myValue = **this;
+      return &myValue;
+    }
+    reference operator[]( difference_type n ) const
+    { return *( *this + n ); }
+
+    Iterator& operator++()
+    {
+      myPoint += myCurve->step( myIndex );
+      ++myIndex;
+      return *this;
+    }
+    Iterator operator++( int )
+    { Iterator tmp( *this ); ++( *this ); return tmp; }
+    Iterator& operator--()
+    {
+      --myIndex;
+      myPoint -= myCurve->step( myIndex );
+      return *this;
+    }
+    Iterator operator--( int )
+    { Iterator tmp( *this ); --( *this ); return tmp; }
+    Iterator& operator+=( difference_type n )
+    {
+      if      ( n ==  1 ) return ++( *this );
+      else if ( n == -1 ) return --( *this );
+      myIndex = (Index) ( (difference_type) myIndex + n );
+      myPoint = myCurve->point( myIndex );
+      return *this;
+    }
+    Iterator& operator-=( difference_type n ) { return *this += -n; }
+    Iterator operator+( difference_type n ) const
+    { Iterator tmp( *this ); return tmp += n; }
+    Iterator operator-( difference_type n ) const
+    { Iterator tmp( *this ); return tmp -= n; }
+    difference_type operator-( const Iterator& other ) const
+    { return (difference_type) myIndex - (difference_type) other.myIndex; }
+
+    bool operator==( const Iterator& o ) const { return myIndex == o.myIndex; }
+    bool operator!=( const Iterator& o ) const { return myIndex != o.myIndex; }
+    bool operator< ( const Iterator& o ) const { return myIndex <  o.myIndex; }
+    bool operator> ( const Iterator& o ) const { return myIndex >  o.myIndex; }
+    bool operator<=( const Iterator& o ) const { return myIndex <= o.myIndex; }
+    bool operator>=( const Iterator& o ) const { return myIndex >= o.myIndex; }
+
+    /// @return the index of the step pointed by the iterator.
+    Index index() const { return myIndex; }
+
+  private:
+    const Self*        myCurve;
+    Index              myIndex;
+    Point              myPoint;
+    mutable value_type myValue;
+  };
+
+  /// A range over the curve, with iterators and circulators.
+  template <typename TFunctor>
+  class Range
+  {
+  public:
+    typedef Iterator<TFunctor>               ConstIterator;
+    typedef DGtal::Circulator<ConstIterator> ConstCirculator;
+
+    Range( const Self* curve ) : myCurve( curve ) {}
+    ConstIterator begin() const { return ConstIterator( myCurve, 0 ); }
+    ConstIterator end() const   { return ConstIterator( myCurve, myCurve->size() ); }
+    ConstCirculator c() const   { return ConstCirculator( begin(), begin(), end() ); }
+    Index size() const          { return myCurve->size(); }
+
+  private:
+    const Self* myCurve;
+  };
+
+  typedef Range<PointFunctor>          PointsRange;
+  typedef Range<IncidentPointsFunctor> IncidentPointsRange;
+
+  // ----------------------- standard services -------------------------
+
+  /// Constructor.
+  /// @param K the Khalimsky space where the curve lies.
+  ChainCodeCurve( const KSpace& K )
+    : myK( K ), mySize( 0 ), myInnerIsLeft( true ) {}
+
+  /// Initializes the curve from a vector of 4-connected points, e.g. the
+  /// output of Surfaces::track2DBoundaryPoints. The curve is closed:
+  /// the last point must be 4-adjacent to the first one.
+  /// @throw DGtal::ConnectivityException if two consecutive points are not 4-adjacent.
+  void initFromVector( const std::vector<Point>& points )
+  {
+    myCodes.clear();
+    myAnchors.clear();
+    mySize = points.size();
+    // The closing point may be repeated or not.
+    if ( mySize > 1 && points.front() == points.back() ) --mySize;
+    if ( mySize < 2 ) throw DGtal::ConnectivityException();
+    myCodes.assign( ( mySize + 31 ) / 32, 0 );
+    myAnchors.reserve( mySize / 32 + 1 );
+    for ( Index i = 0; i < mySize; ++i )
+      {
+        if ( i % 32 == 0 ) myAnchors.push_back( points[ i ] );
+        const Point& p = points[ i ];
+        const Point& q = points[ ( i + 1 ) % mySize ];
+        const Code   c = toCode( q - p );
+        myCodes[ i / 32 ] |= Word( c ) << ( 2 * ( i % 32 ) );
+      }
+    if ( mySize % 32 == 0 ) myAnchors.push_back( points[ 0 ] );
+    myInnerIsLeft = gridCurveInnerIsLeft( myK );
+  }
+
+  /// Asks GridCurve on which side of a step its inner point lies, so that
+  /// both curve types give the same incident points.
+  /// @return 'true' if the inner point of a step is on its left.
+  static bool gridCurveInnerIsLeft( const KSpace& K )
+  {
+    const Point p = K.lowerBound();
+    const Point q = p + Vector( 1, 0 );
+    std::vector<Point> two;
+    two.push_back( p );
+    two.push_back( q );
+    DGtal::GridCurve<KSpace> probe( K );
+    probe.initFromVector( two );
+    const IncidentPoints ip = *probe.getIncidentPointsRange().begin();
+    // the left pixel of a step (1,0) from p is p itself.
+    return ip.first == p;
+  }
+
+  /// @return 'true' if the inner point of each step is on its left.
+  bool innerIsLeft() const { return myInnerIsLeft; }
+
+  /// @return the number of steps of the curve.
+  Index size() const { return mySize; }
+
+  /// The curve is always closed.
+  bool isOpen() const   { return false; }
+  bool isClosed() const { return true; }
+
+  /// @return the Khalimsky space of the curve.
+  const KSpace& space() const { return myK; }
+
+  /// @return the Freeman code of the step at index \a i.
+  Code code( Index i ) const
+  {
+    return Code( ( myCodes[ i / 32 ] >> ( 2 * ( i % 32 ) ) ) & 3 );
+  }
+
+  /// @return the displacement of the step at index \a i.
+  Vector step( Index i ) const
+  {
+    static const int dx[ 4 ] = { 1, 0, -1,  0 };
+    static const int dy[ 4 ] = { 0, 1,  0, -1 };
+    const Code c = code( i );
+    return Vector( dx[ c ], dy[ c ] );
+  }
+
+  /// @return the point at index \a i (0 <= i <= size()).
+  Point point( Index i ) const
+  {
+    Point p = myAnchors[ i / 32 ];
+    for ( Index j = i - i % 32; j < i; ++j ) p += step( j );
+    return p;
+  }
+
+  /// @return the (inner, outer) pixels of the step starting at \a p
+  /// with code \a c.
+  IncidentPoints incidentPoints( const Point& p, Code c ) const
+  {
+    return incidentPoints( p, c, myInnerIsLeft );
+  }
+
+  /// @return the (inner, outer) pixels of the step starting at \a p
+  /// with code \a c, the inner one being on the left if \a innerIsLeft.
+  static IncidentPoints incidentPoints( const Point& p, Code c, bool innerIsLeft )
+  {
+    static const int dx[ 4 ] = { 1, 0, -1,  0 };
+    static const int dy[ 4 ] = { 0, 1,  0, -1 };
+    // d is the step, n its left normal.
+    const int d0 = dx[ c ], d1 = dy[ c ];
+    const int n0 = -d1,     n1 = d0;
+    const Point left ( p[ 0 ] + ( d0 + n0 - 1 ) / 2, p[ 1 ] + ( d1 + n1 - 1 ) / 2 );
+    const Point right( p[ 0 ] + ( d0 - n0 - 1 ) / 2, p[ 1 ] + ( d1 - n1 - 1 ) / 2 );
+    return innerIsLeft ? IncidentPoints( left, right )
+                       : IncidentPoints( right, left );
+  }
+
+  /// @return the range of points of the curve.
+  PointsRange getPointsRange() const { return PointsRange( this ); }
+
+  /// @return the range of (inner, outer) pixels of each step.
+  IncidentPointsRange getIncidentPointsRange() const
+  { return IncidentPointsRange( this ); }
+
+  /// @return the number of bytes used by the curve data.
+  std::size_t memory() const
+  {
+    return sizeof( Self )
+      + myCodes.capacity() * sizeof( Word )
+      + myAnchors.capacity() * sizeof( Point );
+  }
+
+  /// @return the Freeman code of the unit vector \a v.
+  /// @throw DGtal::ConnectivityException if \a v is not a unit vector.
+  static Code toCode( const Vector& v )
+  {
+    if      ( v[ 0 ] ==  1 && v[ 1 ] ==  0 ) return 0;
+    else if ( v[ 0 ] ==  0 && v[ 1 ] ==  1 ) return 1;
+    else if ( v[ 0 ] == -1 && v[ 1 ] ==  0 ) return 2;
+    else if ( v[ 0 ] ==  0 && v[ 1 ] == -1 ) return 3;
+    throw DGtal::ConnectivityException();
+  }
+
+private:
+  KSpace             myK;
+  std::vector<Word>  myCodes;
+  std::vector<Point> myAnchors;
+  Index              mySize;
+  bool               myInnerIsLeft;
+};
@@ -0,0 +1,249 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+#include "DGtal/base/Common.h"
+#include "DGtal/helpers/StdDefs.h"
+#include "DGtal/helpers/Shortcuts.h"
+#include "DGtal/math/MPolynomial.h"
+
+#include "common/Parallel.h"
+
+/// A trivariate polynomial compiled into a flat list of monomials, and
+/// evaluated along rows of voxels.
+///
+/// For a row (y,z), the monomials are first reduced to a polynomial in x,
+/// which is then evaluated with Horner's scheme on all the voxels of the
+/// row at once: 8 or 4 lanes with AVX-512 or AVX2 when the compiler
+/// targets them (e.g. with -march=native), a scalar loop otherwise. All
+/// code paths use the same operations in the same order.
+class CompiledPolynomial3
+{
+public:
+  typedef DGtal::MPolynomial<3,double>          Polynomial3;
+  typedef DGtal::Shortcuts<DGtal::Z3i::KSpace>  SH;
+
+  /// A monomial c x^i y^j z^k.
+  struct Monomial
+  {
+    double c;
+    int    i, j, k;
+  };
+
+  /// The zero polynomial.
+  CompiledPolynomial3() : myDegreeX( 0 ), myDegreeY( 0 ), myDegreeZ( 0 ) {}
+
+  /// Compiles \a P. The outer variable of \a P is x, as in
+  /// ImplicitPolynomial3Shape::operator().
+  explicit CompiledPolynomial3( const Polynomial3& P )
+    : myDegreeX( 0 ), myDegreeY( 0 ), myDegreeZ( 0 )
+  {
+    for ( int i = 0; i <= P.degree(); ++i )
+      for ( int j = 0; j <= P[ i ].degree(); ++j )
+        for ( int k = 0; k <= P[ i ][ j ].degree(); ++k )
+          {
+            const double c = static_cast<double>( P[ i ][ j ][ k ] );
+            if ( c == 0.0 ) continue;
+            Monomial m = { c, i, j, k };
+            myMonomials.push_back( m );
+            myDegreeX = std::max( myDegreeX, i );
+            myDegreeY = std::max( myDegreeY, j );
+            myDegreeZ = std::max( myDegreeZ, k );
+          }
+  }
+
+  /// @return the monomials.
+  const std::vector<Monomial>& monomials() const { return myMonomials; }
+
+  /// @return the value at (x,y,z).
+  double operator()( double x, double y, double z ) const
+  {
+    double out;
+    evalRow( x, 0.0, 1, y, z, &out );
+    return out;
+  }
+
+  /// Evaluates the polynomial at (x0 + t dx, y, z) for t = 0..n-1.
+  void evalRow( double x0, double dx, std::size_t n, double y, double z,
+                double* out ) const
+  {
+    // Reduction to a polynomial in x.
+    double c[ 32 ];
+    std::vector<double> big;
+    double* coefs = c;
+    if ( myDegreeX >= 32 ) { big.resize( myDegreeX + 1 ); coefs = big.data(); }
+    std::fill( coefs, coefs + myDegreeX + 1, 0.0 );
+    for ( const auto& m : myMonomials )
+      coefs[ m.i ] += m.c * ipow( y, m.j ) * ipow( z, m.k );
+
+    std::size_t t = 0;
+#if defined(__AVX512F__)
+    const __m512d vdx = _mm512_set1_pd( dx );
+    const __m512d vx0 = _mm512_set1_pd( x0 );
+    for ( ; t + 8 <= n; t += 8 )
+      {
+        const __m512d vt = _mm512_set_pd( t + 7., t + 6., t + 5., t + 4.,
+                                          t + 3., t + 2., t + 1., t + 0. );
+        const __m512d vx = _mm512_add_pd( vx0, _mm512_mul_pd( vt, vdx ) );
+        __m512d r = _mm512_set1_pd( coefs[ myDegreeX ] );
+        for ( int d = myDegreeX - 1; d >= 0; --d )
+          r = _mm512_add_pd( _mm512_mul_pd( r, vx ), _mm512_set1_pd( coefs[ d ] ) );
+        _mm512_storeu_pd( out + t, r );
+      }
+#elif defined(__AVX2__)
+    const __m256d vdx = _mm256_set1_pd( dx );
+    const __m256d vx0 = _mm256_set1_pd( x0 );
+    for ( ; t + 4 <= n; t += 4 )
+      {
+        const __m256d vt = _mm256_set_pd( t + 3., t + 2., t + 1., t + 0. );
+        const __m256d vx = _mm256_add_pd( vx0, _mm256_mul_pd( vt, vdx ) );
+        __m256d r = _mm256_set1_pd( coefs[ myDegreeX ] );
+        for ( int d = myDegreeX - 1; d >= 0; --d )
+          r = _mm256_add_pd( _mm256_mul_pd( r, vx ), _mm256_set1_pd( coefs[ d ] ) );
+        _mm256_storeu_pd( out + t, r );
+      }
+#endif
+    for ( ; t < n; ++t )
+      {
+        const double x = x0 + double( t ) * dx;
+        double r = coefs[ myDegreeX ];
+        for ( int d = myDegreeX - 1; d >= 0; --d )
+          r = r * x + coefs[ d ];
+        out[ t ] = r;
+      }
+  }
+
+  /// Tables of powers of evalWithGradient, to be reused from one call to
+  /// the next (e.g. one per thread).
+  struct PowerTables
+  {
+    std::vector<double> px, py, pz;
+  };
+
+  /// Evaluates the polynomial \a f and its gradient (\a gx, \a gy, \a gz)
+  /// at the \a n points (x[t],y[t],z[t]). Powers of the coordinates are
+  /// tabulated once in \a tables, then each monomial and its derivatives
+  /// are accumulated by loops over the points, that the compiler
+  /// vectorizes.
+  void evalWithGradient( const double* x, const double* y, const double* z,
+                         std::size_t n, double* f,
+                         double* gx, double* gy, double* gz,
+                         PowerTables& tables ) const
+  {
+    std::vector<double>& px = tables.px;
+    std::vector<double>& py = tables.py;
+    std::vector<double>& pz = tables.pz;
+    powers( x, n, myDegreeX, px );
+    powers( y, n, myDegreeY, py );
+    powers( z, n, myDegreeZ, pz );
+    std::fill( f,  f  + n, 0.0 );
+    std::fill( gx, gx + n, 0.0 );
+    std::fill( gy, gy + n, 0.0 );
+    std::fill( gz, gz + n, 0.0 );
+    for ( const auto& m : myMonomials )
+      {
+        const double* a = px.data() + m.i * n;
+        const double* b = py.data() + m.j * n;
+        const double* c = pz.data() + m.k * n;
+        for ( std::size_t t = 0; t < n; ++t )
+          f[ t ] += m.c * a[ t ] * b[ t ] * c[ t ];
+        if ( m.i > 0 )
+          {
+            const double  ci = m.c * m.i;
+            const double* a1 = a - n;
+            for ( std::size_t t = 0; t < n; ++t ) gx[ t ] += ci * a1[ t ] * b[ t ] * c[ t ];
+          }
+        if ( m.j > 0 )
+          {
+            const double  cj = m.c * m.j;
+            const double* b1 = b - n;
+            for ( std::size_t t = 0; t < n; ++t ) gy[ t ] += cj * a[ t ] * b1[ t ] * c[ t ];
+          }
+        if ( m.k > 0 )
+          {
+            const double  ck = m.c * m.k;
+            const double* c1 = c - n;
+            for ( std::size_t t = 0; t < n; ++t ) gz[ t ] += ck * a[ t ] * b[ t ] * c1[ t ];
+          }
+      }
+  }
+
+  /// @return the binary image of the Gauss digitization \a dshape of the
+  /// shape {f < 0}, as SH3::makeBinaryImage( dshape, params ) without
+  /// noise. Rows are evaluated on \a nbThreads threads. Values too close
+  /// to 0 to be sure of their sign are re-evaluated by \a dshape.
+  DGtal::CountedPtr<SH::BinaryImage>
+  makeBinaryImage( DGtal::CountedPtr<SH::DigitizedImplicitShape3D> dshape,
+                   unsigned int nbThreads = 0 ) const
+  {
+    typedef SH::Point Point;
+    const SH::Domain domain = dshape->getDomain();
+    const Point lo = domain.lowerBound();
+    const Point hi = domain.upperBound();
+    const std::size_t w  = hi[ 0 ] - lo[ 0 ] + 1;
+    const std::size_t nh = hi[ 1 ] - lo[ 1 ] + 1;
+    const std::size_t nd = hi[ 2 ] - lo[ 2 ] + 1;
+    std::vector<unsigned char> mask( w * nh * nd );
+    parallelFor( nh * nd, [&] ( std::size_t r )
+      {
+        const Point p( lo[ 0 ], lo[ 1 ] + int( r % nh ), lo[ 2 ] + int( r / nh ) );
+        std::vector<double> values( w );
+        evalRow( *dshape, p, w, values.data() );
+        for ( std::size_t x = 0; x < w; ++x )
+          mask[ r * w + x ] = isInside( *dshape, p + Point( int( x ), 0, 0 ), values[ x ] );
+      }, nbThreads );
+    DGtal::CountedPtr<SH::BinaryImage> bimage( new SH::BinaryImage( domain ) );
+    std::size_t idx = 0;
+    for ( auto it = bimage->begin(), ite = bimage->end(); it != ite; ++it, ++idx )
+      *it = mask[ idx ] != 0;
+    return bimage;
+  }
+
+  /// Evaluates the polynomial at the embedding of the \a n voxels
+  /// starting at \a p along x.
+  void evalRow( const SH::DigitizedImplicitShape3D& dshape, const SH::Point& p,
+                std::size_t n, double* out ) const
+  {
+    const auto a = dshape.embed( p );
+    const auto b = dshape.embed( p + SH::Point( 1, 0, 0 ) );
+    evalRow( a[ 0 ], b[ 0 ] - a[ 0 ], n, a[ 1 ], a[ 2 ], out );
+  }
+
+  /// @return 'true' if voxel \a p of value \a v is in the digitization.
+  bool isInside( const SH::DigitizedImplicitShape3D& dshape,
+                 const SH::Point& p, double v ) const
+  {
+    return std::abs( v ) > 1e-9 ? v < 0.0 : dshape( p );
+  }
+
+protected:
+  std::vector<Monomial> myMonomials;
+  int                   myDegreeX;
+  int                   myDegreeY;
+  int                   myDegreeZ;
+
+  /// Tabulates u^d for d = 0..degree in \a p (p[ d * n + t ] = u[t]^d).
+  static void powers( const double* u, std::size_t n, int degree,
+                      std::vector<double>& p )
+  {
+    p.resize( ( degree + 1 ) * n );
+    std::fill( p.begin(), p.begin() + n, 1.0 );
+    for ( int d = 1; d <= degree; ++d )
+      for ( std::size_t t = 0; t < n; ++t )
+        p[ d * n + t ] = p[ ( d - 1 ) * n + t ] * u[ t ];
+  }
+
+  static double ipow( double x, int e )
+  {
+    double r = 1.0;
+    for ( ; e > 0; --e ) r *= x;
+    return r;
+  }
+};
@@ -0,0 +1,375 @@
+#pragma once
+
+#include <vector>
+#include <utility>
+#include <unordered_map>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+#include <cstddef>
+
+#include "DGtal/base/Common.h"
+#include "DGtal/helpers/StdDefs.h"
+
+#include "common/Parallel.h"
+
+/// Connected components of the voxels of a binary image, of both the
+/// foreground and the background, with their sizes and bounding boxes,
+/// and the components of its boundary surfels.
+///
+/// Each row of the image along x is cut into runs of equal voxels. Runs
+/// are labelled by union-find: z-slabs are scanned on several threads,
+/// each uniting the runs of its rows with the overlapping runs of the
+/// previous rows of the slab (a slab only touches its own runs), then
+/// the first plane of each slab is united with the last plane of the
+/// previous one. Unions keep the smallest run as root, so components are
+/// numbered in scan order whatever the number of threads.
+///
+/// The foreground is 6- or 18-connected and the background the other
+/// one. The voxels outside the domain form one more background
+/// component, adjacent to the background voxels of the domain border.
+///
+/// A boundary surfel separates a foreground component from a background
+/// component, and the surfels between two such components form a single
+/// connected digital surface (6/18 or 18/6 Jordan theorem), so surfel
+/// components are these pairs of components (see labelSurfels()). With
+/// Shortcuts, "surfelAdjacency" 0 (interior) is the 6/18 case and 1
+/// (exterior) the 18/6 case.
+class ConnectedComponents
+{
+public:
+  typedef DGtal::Z3i::Point Point;
+  typedef std::uint32_t     Index; ///< index of a run
+
+  /// A component of voxels.
+  struct Component
+  {
+    bool        foreground = false;
+    std::size_t size       = 0; ///< number of voxels (0 for the outside)
+    Point       lower, upper;   ///< bounding box of its voxels
+    Point       first;          ///< first voxel in scan order (z, y, then x)
+  };
+
+  /// A component of boundary surfels.
+  struct SurfelComponent
+  {
+    std::size_t inner = 0;  ///< foreground component
+    std::size_t outer = 0;  ///< background component
+    std::size_t size  = 0;  ///< number of surfels
+    Point       lower, upper; ///< bounding box of their Khalimsky coordinates
+  };
+
+  /// The components of a range of surfels.
+  struct SurfelComponents
+  {
+    std::vector<std::size_t>     labels;     ///< component of each surfel
+    std::vector<SurfelComponent> components; ///< in order of first surfel
+
+    /// @return the biggest component (the first one of equal sizes).
+    std::size_t biggest() const
+    {
+      std::size_t b = 0;
+      for ( std::size_t c = 1; c < components.size(); ++c )
+        if ( components[ c ].size > components[ b ].size ) b = c;
+      return b;
+    }
+
+    /// @return the surfels of \a surfels in component \a c, in order.
+    template <typename TSurfelRange>
+    TSurfelRange select( const TSurfelRange& surfels, std::size_t c ) const
+    {
+      TSurfelRange result;
+      result.reserve( c < components.size() ? components[ c ].size : 0 );
+      for ( std::size_t i = 0; i < surfels.size(); ++i )
+        if ( labels[ i ] == c ) result.push_back( surfels[ i ] );
+      return result;
+    }
+  };
+
+  /// Labels the voxels of \a image.
+  /// @tparam TImage a 3D image of bool (e.g. Shortcuts::BinaryImage).
+  /// @param foregroundAdjacency 6 or 18 (the background is 18 or 6).
+  /// @param nbThreads the number of threads (0 means all cores).
+  /// @param slabThickness the number of planes per slab (0 gives about 4
+  /// slabs per thread).
+  template <typename TImage>
+  explicit ConnectedComponents( const TImage& image, int foregroundAdjacency = 6,
+                                unsigned int nbThreads = 0, int slabThickness = 0 )
+    : myLower( image.domain().lowerBound() ),
+      myUpper( image.domain().upperBound() ),
+      myForeground18( foregroundAdjacency == 18 )
+  {
+    if ( foregroundAdjacency != 6 && foregroundAdjacency != 18 )
+      throw std::invalid_argument( "ConnectedComponents: adjacency must be 6 or 18" );
+    if ( nbThreads == 0 ) nbThreads = defaultNumberOfThreads();
+    const Point size = myUpper - myLower + Point::diagonal( 1 );
+    mySizeY = size[ 1 ];
+    const int nbPlanes = size[ 2 ];
+    const int thickness = slabThickness > 0 ? slabThickness
+      : std::max( 1, nbPlanes / int( 4 * nbThreads ) );
+    const std::size_t nbSlabs = std::size_t( ( nbPlanes + thickness - 1 ) / thickness );
+    auto slabBegin = [&] ( std::size_t s ) { return myLower[ 2 ] + int( s ) * thickness; };
+    auto slabEnd   = [&] ( std::size_t s ) { return std::min( slabBegin( s ) + thickness, myUpper[ 2 ] + 1 ); };
+
+    // Runs of each slab, then all runs in row order.
+    std::vector< std::vector<int> >           starts( nbSlabs );
+    std::vector< std::vector<unsigned char> > values( nbSlabs );
+    std::vector< std::vector<Index> >         rowEnds( nbSlabs );
+    parallelFor( nbSlabs, [&] ( std::size_t s )
+      {
+        for ( int z = slabBegin( s ); z < slabEnd( s ); ++z )
+          for ( int y = myLower[ 1 ]; y <= myUpper[ 1 ]; ++y )
+            {
+              bool previous = false;
+              for ( int x = myLower[ 0 ]; x <= myUpper[ 0 ]; ++x )
+                {
+                  const bool v = image( Point( x, y, z ) );
+                  if ( x == myLower[ 0 ] || v != previous )
+                    {
+                      starts[ s ].push_back( x );
+                      values[ s ].push_back( v ? 1 : 0 );
+                    }
+                  previous = v;
+                }
+              rowEnds[ s ].push_back( Index( starts[ s ].size() ) );
+            }
+      }, nbThreads );
+    std::vector<std::size_t> offset( nbSlabs + 1, 0 );
+    for ( std::size_t s = 0; s < nbSlabs; ++s )
+      offset[ s + 1 ] = offset[ s ] + starts[ s ].size();
+    if ( offset.back() >= std::size_t( Index( -1 ) ) )
+      throw std::length_error( "ConnectedComponents: too many runs" );
+    const std::size_t nbRows = std::size_t( size[ 1 ] ) * size[ 2 ];
+    myRunStart.resize( offset.back() );
+    myRunValue.resize( offset.back() );
+    myRowStart.assign( nbRows + 1, 0 );
+    myParent.resize( offset.back() + 1 ); // the last node is the outside
+    myParent.back() = Index( offset.back() );
+    std::vector<Index> borderRun( nbSlabs, Index( -1 ) ); // background run on the border
+
+    // Runs in place and unions within each slab.
+    parallelFor( nbSlabs, [&] ( std::size_t s )
+      {
+        std::copy( starts[ s ].begin(), starts[ s ].end(), myRunStart.begin() + offset[ s ] );
+        std::copy( values[ s ].begin(), values[ s ].end(), myRunValue.begin() + offset[ s ] );
+        const std::size_t firstRow = row( myLower[ 1 ], slabBegin( s ) );
+        for ( std::size_t r = 0; r < rowEnds[ s ].size(); ++r )
+          myRowStart[ firstRow + r + 1 ] = Index( offset[ s ] + rowEnds[ s ][ r ] );
+        for ( std::size_t i = offset[ s ]; i < offset[ s + 1 ]; ++i )
+          myParent[ i ] = Index( i );
+        std::vector<int>().swap( starts[ s ] );
+        std::vector<unsigned char>().swap( values[ s ] );
+      }, nbThreads );
+    parallelFor( nbSlabs, [&] ( std::size_t s )
+      {
+        for ( int z = slabBegin( s ); z < slabEnd( s ); ++z )
+          for ( int y = myLower[ 1 ]; y <= myUpper[ 1 ]; ++y )
+            {
+              if ( y > myLower[ 1 ] ) uniteRows( y, z, y - 1, z, true );
+              if ( z > slabBegin( s ) ) uniteWithPreviousPlane( y, z );
+              // Background runs on the border, to be united with the outside.
+              const bool borderRow = y == myLower[ 1 ] || y == myUpper[ 1 ]
+                || z == myLower[ 2 ] || z == myUpper[ 2 ];
+              const std::size_t r = row( y, z );
+              for ( Index i = myRowStart[ r ]; i < myRowStart[ r + 1 ]; ++i )
+                if ( ! myRunValue[ i ]
+                     && ( borderRow || i == myRowStart[ r ] || i + 1 == myRowStart[ r + 1 ] ) )
+                  {
+                    if ( borderRun[ s ] == Index( -1 ) ) borderRun[ s ] = i;
+                    else unite( borderRun[ s ], i );
+                  }
+            }
+      }, nbThreads );
+    // Unions across slabs and with the outside.
+    for ( std::size_t s = 0; s < nbSlabs; ++s )
+      {
+        if ( s > 0 )
+          for ( int y = myLower[ 1 ]; y <= myUpper[ 1 ]; ++y )
+            uniteWithPreviousPlane( y, slabBegin( s ) );
+        if ( borderRun[ s ] != Index( -1 ) ) unite( borderRun[ s ], myParent.size() - 1 );
+      }
+
+    // Components in order of their first run (their root).
+    myLabel.resize( myParent.size() );
+    for ( std::size_t i = 0; i < myParent.size(); ++i )
+      {
+        const Index r = find( Index( i ) );
+        if ( r == i )
+          {
+            myLabel[ i ] = myComponents.size();
+            myComponents.push_back( Component() );
+            myComponents.back().foreground = i + 1 < myParent.size() && myRunValue[ i ];
+          }
+        else myLabel[ i ] = myLabel[ r ];
+      }
+    std::vector<Index>().swap( myParent );
+    std::vector<bool> seen( myComponents.size(), false );
+    for ( int z = myLower[ 2 ]; z <= myUpper[ 2 ]; ++z )
+      for ( int y = myLower[ 1 ]; y <= myUpper[ 1 ]; ++y )
+        {
+          const std::size_t r = row( y, z );
+          for ( Index i = myRowStart[ r ]; i < myRowStart[ r + 1 ]; ++i )
+            {
+              const std::size_t c = myLabel[ i ];
+              Component& C = myComponents[ c ];
+              const Point lo( myRunStart[ i ], y, z ), hi( runEnd( i, r ), y, z );
+              C.size  += std::size_t( hi[ 0 ] - lo[ 0 ] + 1 );
+              if ( ! seen[ c ] ) C.first = lo;
+              C.lower  = seen[ c ] ? C.lower.inf( lo ) : lo;
+              C.upper  = seen[ c ] ? C.upper.sup( hi ) : hi;
+              seen[ c ] = true;
+            }
+        }
+  }
+
+  /// @return the components of voxels, in scan order.
+  const std::vector<Component>& components() const { return myComponents; }
+
+  /// @return the number of components of voxels.
+  std::size_t nbComponents() const { return myComponents.size(); }
+
+  /// @return the component of the voxels outside the domain.
+  std::size_t outside() const { return myLabel.back(); }
+
+  /// @return the component of voxel \a p (outside() if not in the domain).
+  std::size_t label( const Point& p ) const
+  {
+    for ( int k = 0; k < 3; ++k )
+      if ( p[ k ] < myLower[ k ] || p[ k ] > myUpper[ k ] ) return outside();
+    const std::size_t r = row( p[ 1 ], p[ 2 ] );
+    const auto first = myRunStart.begin() + myRowStart[ r ];
+    const auto last  = myRunStart.begin() + myRowStart[ r + 1 ];
+    return myLabel[ std::size_t( std::upper_bound( first, last, p[ 0 ] ) - myRunStart.begin() ) - 1 ];
+  }
+
+  /// @return the biggest foreground (or background) component (the first
+  /// one of equal sizes), or nbComponents() if there is none.
+  std::size_t biggest( bool foreground = true ) const
+  {
+    std::size_t b = nbComponents();
+    for ( std::size_t c = 0; c < nbComponents(); ++c )
+      if ( myComponents[ c ].foreground == foreground
+           && ( b == nbComponents() || myComponents[ c ].size > myComponents[ b ].size ) )
+        b = c;
+    return b;
+  }
+
+  /// @return the components of the boundary surfels \a surfels (e.g. of
+  /// SurfelStream), one per pair of foreground and background components
+  /// they separate, in order of first surfel.
+  /// @param K the Khalimsky space of the surfels.
+  /// @param nbThreads the number of threads (0 means all cores).
+  template <typename TKSpace, typename TSurfelRange>
+  SurfelComponents labelSurfels( const TKSpace& K, const TSurfelRange& surfels,
+                                 unsigned int nbThreads = 0 ) const
+  {
+    SurfelComponents S;
+    // Components on both sides of each surfel.
+    std::vector< std::pair<std::size_t,std::size_t> > sides( surfels.size() );
+    parallelFor( surfels.size(), [&] ( std::size_t i )
+      {
+        const auto  k = K.sOrthDir( surfels[ i ] );
+        sides[ i ] = std::make_pair( label( K.sCoords( K.sDirectIncident( surfels[ i ], k ) ) ),
+                                     label( K.sCoords( K.sIndirectIncident( surfels[ i ], k ) ) ) );
+      }, nbThreads, 4096 );
+    std::unordered_map<std::uint64_t,std::size_t> ids;
+    S.labels.resize( surfels.size() );
+    for ( std::size_t i = 0; i < surfels.size(); ++i )
+      {
+        const std::uint64_t key = ( std::uint64_t( sides[ i ].first ) << 32 )
+          | std::uint64_t( sides[ i ].second );
+        auto it = ids.find( key );
+        if ( it == ids.end() )
+          {
+            it = ids.insert( std::make_pair( key, S.components.size() ) ).first;
+            SurfelComponent C;
+            C.inner = sides[ i ].first;
+            C.outer = sides[ i ].second;
+            C.lower = C.upper = K.sKCoords( surfels[ i ] );
+            S.components.push_back( C );
+          }
+        SurfelComponent& C = S.components[ it->second ];
+        const Point p = K.sKCoords( surfels[ i ] );
+        C.size  += 1;
+        C.lower  = C.lower.inf( p );
+        C.upper  = C.upper.sup( p );
+        S.labels[ i ] = it->second;
+      }
+    return S;
+  }
+
+protected:
+  Point                       myLower, myUpper;
+  bool                        myForeground18;
+  int                         mySizeY = 0;
+  std::vector<int>            myRunStart; ///< first x of each run
+  std::vector<unsigned char>  myRunValue; ///< 1 for foreground runs
+  std::vector<Index>          myRowStart; ///< runs of row r are [myRowStart[r],myRowStart[r+1])
+  std::vector<Index>          myParent;   ///< union-find forest (while labelling)
+  std::vector<std::size_t>    myLabel;    ///< component of each run, then of the outside
+  std::vector<Component>      myComponents;
+
+  std::size_t row( int y, int z ) const
+  {
+    return std::size_t( y - myLower[ 1 ] ) + std::size_t( mySizeY ) * std::size_t( z - myLower[ 2 ] );
+  }
+
+  int runEnd( Index i, std::size_t r ) const
+  {
+    return i + 1 < myRowStart[ r + 1 ] ? myRunStart[ i + 1 ] - 1 : myUpper[ 0 ];
+  }
+
+  Index find( Index i )
+  {
+    while ( myParent[ i ] != i )
+      {
+        myParent[ i ] = myParent[ myParent[ i ] ];
+        i = myParent[ i ];
+      }
+    return i;
+  }
+
+  /// Unites the trees of \a a and \a b, under the smallest root.
+  void unite( std::size_t a, std::size_t b )
+  {
+    Index ra = find( Index( a ) ), rb = find( Index( b ) );
+    if ( ra == rb ) return;
+    if ( ra < rb ) myParent[ rb ] = ra;
+    else           myParent[ ra ] = rb;
+  }
+
+  /// Unites the runs of row (y,z) with the runs of rows (y,z-1) and, for
+  /// 18-connected voxels, (y-1,z-1) and (y+1,z-1).
+  void uniteWithPreviousPlane( int y, int z )
+  {
+    uniteRows( y, z, y, z - 1, true );
+    if ( y > myLower[ 1 ] ) uniteRows( y, z, y - 1, z - 1, false );
+    if ( y < myUpper[ 1 ] ) uniteRows( y, z, y + 1, z - 1, false );
+  }
+
+  /// Unites the adjacent runs of equal values of rows (y,z) and (y2,z2).
+  /// @param faceRows when 'true', the rows share faces of voxels, and
+  /// 18-connected runs are adjacent if they overlap up to one voxel;
+  /// otherwise the rows only share edges, and only 18-connected runs that
+  /// overlap are adjacent.
+  void uniteRows( int y, int z, int y2, int z2, bool faceRows )
+  {
+    const std::size_t r = row( y, z ), r2 = row( y2, z2 );
+    Index j = myRowStart[ r2 ];
+    for ( Index i = myRowStart[ r ]; i < myRowStart[ r + 1 ]; ++i )
+      {
+        const int x0 = myRunStart[ i ], x1 = runEnd( i, r );
+        // Skips the runs ending before x0 - 1.
+        while ( j < myRowStart[ r2 + 1 ] && runEnd( j, r2 ) < x0 - 1 ) ++j;
+        for ( Index k = j; k < myRowStart[ r2 + 1 ] && myRunStart[ k ] <= x1 + 1; ++k )
+          {
+            if ( myRunValue[ k ] != myRunValue[ i ] ) continue;
+            const bool is18   = myRunValue[ i ] ? myForeground18 : ! myForeground18;
+            if ( ! faceRows && ! is18 ) continue;
+            const int  margin = faceRows && is18 ? 1 : 0;
+            if ( myRunStart[ k ] <= x1 + margin && runEnd( k, r2 ) >= x0 - margin )
+              unite( i, k );
+          }
+      }
+  }
+};
@@ -0,0 +1,212 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include "common/Parallel.h"
+
+/// Extracts every boundary contour of a 2D binary image, in parallel.
+///
+/// A boundary edge separates a foreground pixel from a background one
+/// (outside the image is background). Contours are followed with the
+/// foreground on a fixed side, with 4-connected foreground (diagonal
+/// configurations are split), so outer boundaries and hole boundaries are
+/// all returned, as closed sequences of 4-connected pointels.
+///
+/// Pixel (x,y) has pointels (x,y), (x+1,y), (x+1,y+1), (x,y+1), as in the
+/// Khalimsky space where pixel p has coordinates 2p+1 and pointel q has 2q.
+///
+/// Workers scan bands of rows and follow the contours starting at the
+/// edges they claim first (atomic marks). A contour reached concurrently by
+/// several workers is followed again, sequentially, after the parallel
+/// phase. The output does not depend on the scheduling: every contour
+/// starts at its lowest edge and contours are sorted by starting edge.
+class ContourExtraction2D
+{
+public:
+  typedef std::int64_t EdgeId;
+
+  /// @param mask the w x h foreground mask (row-major, non-zero is foreground).
+  ContourExtraction2D( const std::vector<unsigned char>& mask, int w, int h )
+    : myMask( mask ), myW( w ), myH( h ) {}
+
+  /// Extracts all the contours.
+  /// @param[out] contours the contours, as pointels given by a functor
+  /// \a toPoint( x, y ) (e.g. adding the lower bound of the image domain).
+  /// @param foregroundOnLeft when 'true', the foreground lies on the left of
+  /// each step (outer boundaries are counterclockwise), otherwise on its right.
+  /// @param nbThreads the number of threads (0 means all cores).
+  template <typename TPoint, typename ToPoint>
+  void extract( std::vector< std::vector<TPoint> >& contours,
+                const ToPoint& toPoint,
+                bool foregroundOnLeft = true,
+                unsigned int nbThreads = 0 ) const
+  {
+    const std::size_t nbPixels = std::size_t( myW ) * std::size_t( myH );
+    std::unique_ptr< std::atomic<unsigned char>[] >
+      marks( new std::atomic<unsigned char>[ nbPixels ] );
+    parallelFor( nbPixels, [&marks] ( std::size_t i ) { marks[ i ] = 0; },
+                 nbThreads, 65536 );
+
+    const unsigned int nbWorkers = nbThreads == 0
+      ? defaultNumberOfThreads() : nbThreads;
+    std::vector< std::vector<EdgeId> > contested( nbWorkers );
+    std::mutex contoursMutex;
+    std::vector< std::vector<EdgeId> > tracked;
+
+    // Parallel phase: scan bands of rows and follow claimed contours.
+    parallelForChunks( myH, 16, [&] ( std::size_t yb, std::size_t ye,
+                                      unsigned int t )
+      {
+        std::vector<EdgeId> contour;
+        for ( std::size_t y = yb; y < ye; ++y )
+          for ( int x = 0; x < myW; ++x )
+            for ( int s = 0; s < 4; ++s )
+              {
+                const EdgeId e = edge( x, (int) y, s );
+                if ( ! isEdge( e ) ) continue;
+                if ( ! claim( marks.get(), e ) ) continue;
+                if ( follow( marks.get(), e, contour ) )
+                  {
+                    std::lock_guard<std::mutex> lock( contoursMutex );
+                    tracked.push_back( contour );
+                  }
+                else contested[ t ].push_back( e );
+              }
+      }, nbWorkers );
+
+    // Sequential phase: contours reached by several workers.
+    std::set<EdgeId> done;
+    std::vector<EdgeId> contour;
+    for ( const auto& c : contested )
+      for ( EdgeId e : c )
+        {
+          followAll( e, contour );
+          if ( done.insert( contour[ 0 ] ).second )
+            tracked.push_back( contour );
+        }
+
+    // Deterministic order and conversion to pointels.
+    std::sort( tracked.begin(), tracked.end(),
+               [] ( const std::vector<EdgeId>& a, const std::vector<EdgeId>& b )
+               { return a[ 0 ] < b[ 0 ]; } );
+    contours.resize( tracked.size() );
+    parallelFor( tracked.size(), [&] ( std::size_t i )
+      {
+        const std::vector<EdgeId>& c = tracked[ i ];
+        std::vector<TPoint>& out = contours[ i ];
+        out.clear();
+        out.reserve( c.size() );
+        for ( EdgeId e : c )
+          {
+            int x, y;
+            startPointel( e, x, y );
+            out.push_back( toPoint( x, y ) );
+          }
+        if ( ! foregroundOnLeft ) std::reverse( out.begin(), out.end() );
+      }, nbThreads );
+  }
+
+protected:
+  const std::vector<unsigned char>& myMask;
+  int myW;
+  int myH;
+
+  // Side s of a pixel faces its neighbor in direction o(s), and its edge
+  // goes in direction d(s) = o(s+1), with the pixel on its left.
+  static int ox( int s ) { static const int v[ 4 ] = {  0, 1, 0, -1 }; return v[ s ]; }
+  static int oy( int s ) { static const int v[ 4 ] = { -1, 0, 1,  0 }; return v[ s ]; }
+
+  bool fg( int x, int y ) const
+  {
+    return x >= 0 && y >= 0 && x < myW && y < myH
+      && myMask[ std::size_t( y ) * myW + x ] != 0;
+  }
+
+  EdgeId edge( int x, int y, int s ) const
+  { return ( EdgeId( y ) * myW + x ) * 4 + s; }
+
+  void decode( EdgeId e, int& x, int& y, int& s ) const
+  {
+    s = int( e % 4 );
+    const EdgeId p = e / 4;
+    x = int( p % myW );
+    y = int( p / myW );
+  }
+
+  bool isEdge( EdgeId e ) const
+  {
+    int x, y, s;
+    decode( e, x, y, s );
+    return fg( x, y ) && ! fg( x + ox( s ), y + oy( s ) );
+  }
+
+  void startPointel( EdgeId e, int& px, int& py ) const
+  {
+    static const int sx[ 4 ] = { 0, 1, 1, 0 };
+    static const int sy[ 4 ] = { 0, 0, 1, 1 };
+    int x, y, s;
+    decode( e, x, y, s );
+    px = x + sx[ s ];
+    py = y + sy[ s ];
+  }
+
+  /// @return the edge following \a e along the contour.
+  EdgeId next( EdgeId e ) const
+  {
+    int x, y, s;
+    decode( e, x, y, s );
+    const int d  = ( s + 1 ) % 4;
+    const int qx = x + ox( d ), qy = y + oy( d );
+    if ( ! fg( qx, qy ) ) return edge( x, y, d );           // turn left
+    const int rx = qx + ox( s ), ry = qy + oy( s );
+    if ( ! fg( rx, ry ) ) return edge( qx, qy, s );         // straight
+    return edge( rx, ry, ( s + 3 ) % 4 );                   // turn right
+  }
+
+  /// Atomically marks \a e. @return 'true' if it was not marked before.
+  static bool claim( std::atomic<unsigned char>* marks, EdgeId e )
+  {
+    const unsigned char bit = (unsigned char) ( 1 << ( e % 4 ) );
+    return ( marks[ e / 4 ].fetch_or( bit ) & bit ) == 0;
+  }
+
+  /// Follows the contour from the claimed edge \a e, claiming its edges.
+  /// @return 'false' if another worker claimed one of them.
+  bool follow( std::atomic<unsigned char>* marks, EdgeId e,
+               std::vector<EdgeId>& contour ) const
+  {
+    contour.clear();
+    contour.push_back( e );
+    for ( EdgeId f = next( e ); f != e; f = next( f ) )
+      {
+        if ( ! claim( marks, f ) ) return false;
+        contour.push_back( f );
+      }
+    rotateToLowest( contour );
+    return true;
+  }
+
+  /// Follows the whole contour from \a e, regardless of the marks.
+  void followAll( EdgeId e, std::vector<EdgeId>& contour ) const
+  {
+    contour.clear();
+    contour.push_back( e );
+    for ( EdgeId f = next( e ); f != e; f = next( f ) )
+      contour.push_back( f );
+    rotateToLowest( contour );
+  }
+
+  static void rotateToLowest( std::vector<EdgeId>& contour )
+  {
+    std::rotate( contour.begin(),
+                 std::min_element( contour.begin(), contour.end() ),
+                 contour.end() );
+  }
+};
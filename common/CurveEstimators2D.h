@@ -0,0 +1,250 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <iterator>
+
+#include "DGtal/base/Common.h"
+#include "DGtal/helpers/StdDefs.h"
+
+#include "DGtal/geometry/curves/estimation/MostCenteredMaximalSegmentEstimator.h"
+#include "DGtal/geometry/curves/estimation/SegmentComputerEstimators.h"
+#include "DGtal/geometry/curves/StabbingCircleComputer.h"
+#include "DGtal/geometry/curves/ArithmeticalDSSComputer.h"
+#include "DGtal/geometry/curves/SaturatedSegmentation.h"
+#include "DGtal/geometry/curves/estimation/LambdaMST2D.h"
+#include "DGtal/geometry/curves/BinomialConvolver.h"
+
+/// Normal and curvature estimators on 2D grid curves, selected at compile
+/// time. Each estimator is a struct with:
+/// - `static const char* name()`,
+/// - `static bool hasCurvature()`,
+/// - `template <typename TCurve> static void estimate( curve, h, normals, curvatures )`
+///   which gives one normal (and one curvature if available) per step
+///   (linel) of the curve.
+///
+/// TCurve is a closed GridCurve or ChainCodeCurve. Estimators working on
+/// points give their estimates per pointel; they are averaged on the two
+/// ends of each step. Normals are unit vectors but their orientation
+/// depends on the estimator.
+
+typedef DGtal::Z2i::RealVector RealVector2D;
+
+/// Runs a most-centered maximal segment estimator built from the segment
+/// computer \a SegmentComputer and the functor \a aF on [itb,ite).
+template <typename SegmentComputer, typename Functor,
+          typename InputIterator, typename OutputIterator>
+void estimateWithMaximalSegments( const InputIterator& itb,
+                                  const InputIterator& ite,
+                                  const Functor& aF,
+                                  OutputIterator out,
+                                  const double& aH )
+{
+  SegmentComputer sc;
+  DGtal::MostCenteredMaximalSegmentEstimator<SegmentComputer,Functor> estimator( sc, aF );
+  estimator.init( itb, ite );
+  estimator.eval( itb, ite, out, aH );
+}
+
+/// Turns per-pointel tangents into per-step unit normals (left normals).
+inline void tangentsToStepNormals( const std::vector<RealVector2D>& tangents,
+                                   std::vector<RealVector2D>& normals )
+{
+  const std::size_t n = tangents.size();
+  normals.resize( n );
+  for ( std::size_t i = 0; i < n; ++i )
+    {
+      RealVector2D t = tangents[ i ] + tangents[ ( i + 1 ) % n ];
+      const double l = t.norm();
+      if ( l > 0.0 ) t /= l;
+      normals[ i ] = RealVector2D( -t[ 1 ], t[ 0 ] );
+    }
+}
+
+/// Turns per-pointel curvatures into per-step curvatures.
+inline void pointsToSteps( std::vector<double>& values )
+{
+  const std::size_t n = values.size();
+  if ( n == 0 ) return;
+  const double first = values[ 0 ];
+  for ( std::size_t i = 0; i + 1 < n; ++i )
+    values[ i ] = 0.5 * ( values[ i ] + values[ i + 1 ] );
+  values[ n - 1 ] = 0.5 * ( values[ n - 1 ] + first );
+}
+
+//------------------------------------------------------------------------------
+/// Normals and curvatures from digital circular arcs (StabbingCircleComputer),
+/// as in the 2D estimation practical.
+struct DCAEstimator
+{
+  static const char* name() { return "dca"; }
+  static bool hasCurvature() { return true; }
+
+  template <typename TCurve>
+  static void estimate( const TCurve& curve, double h,
+                        std::vector<RealVector2D>& normals,
+                        std::vector<double>& curvatures )
+  {
+    typedef typename TCurve::IncidentPointsRange Range;
+    typedef typename Range::ConstCirculator      Iterator;
+    typedef DGtal::StabbingCircleComputer<Iterator> SegmentComputer;
+    Range range = curve.getIncidentPointsRange();
+    normals.clear();
+    curvatures.clear();
+    estimateWithMaximalSegments<SegmentComputer>
+      ( range.c(), range.c(),
+        DGtal::CurvatureFromDCAEstimator<SegmentComputer,false>(),
+        std::back_inserter( curvatures ), h );
+    estimateWithMaximalSegments<SegmentComputer>
+      ( range.c(), range.c(),
+        DGtal::NormalFromDCAEstimator<SegmentComputer>(),
+        std::back_inserter( normals ), h );
+  }
+};
+
+//------------------------------------------------------------------------------
+/// Tangents from most-centered maximal arithmetical DSS (no curvature).
+struct DSSTangentEstimator
+{
+  static const char* name() { return "dss"; }
+  static bool hasCurvature() { return false; }
+
+  template <typename TCurve>
+  static void estimate( const TCurve& curve, double h,
+                        std::vector<RealVector2D>& normals,
+                        std::vector<double>& curvatures )
+  {
+    typedef typename TCurve::PointsRange    Range;
+    typedef typename Range::ConstCirculator Iterator;
+    typedef DGtal::ArithmeticalDSSComputer<Iterator,int,4> SegmentComputer;
+    Range range = curve.getPointsRange();
+    std::vector<RealVector2D> tangents;
+    tangents.reserve( curve.size() );
+    estimateWithMaximalSegments<SegmentComputer>
+      ( range.c(), range.c(),
+        DGtal::TangentFromDSSEstimator<SegmentComputer>(),
+        std::back_inserter( tangents ), h );
+    tangentsToStepNormals( tangents, normals );
+    curvatures.clear();
+  }
+};
+
+//------------------------------------------------------------------------------
+/// Tangents from the lambda-MST estimator over the saturated DSS
+/// segmentation (no curvature). As in DGtal examples, the point sequence
+/// is segmented as an open range.
+struct LambdaMSTEstimator
+{
+  static const char* name() { return "lmst"; }
+  static bool hasCurvature() { return false; }
+
+  template <typename TCurve>
+  static void estimate( const TCurve& curve, double /*h*/,
+                        std::vector<RealVector2D>& normals,
+                        std::vector<double>& curvatures )
+  {
+    typedef typename TCurve::PointsRange  Range;
+    typedef typename Range::ConstIterator Iterator;
+    typedef DGtal::ArithmeticalDSSComputer<Iterator,int,4> SegmentComputer;
+    typedef DGtal::SaturatedSegmentation<SegmentComputer>  Segmentation;
+    Range range = curve.getPointsRange();
+    Segmentation segmenter( range.begin(), range.end(), SegmentComputer() );
+    DGtal::LambdaMST2D<Segmentation> lmst;
+    lmst.attach( segmenter );
+    lmst.init( range.begin(), range.end() );
+    std::vector<RealVector2D> tangents;
+    tangents.reserve( curve.size() );
+    lmst.eval( range.begin(), range.end(), std::back_inserter( tangents ) );
+    tangentsToStepNormals( tangents, normals );
+    curvatures.clear();
+  }
+};
+
+//------------------------------------------------------------------------------
+/// Tangents and curvatures from binomial convolution of the points, with
+/// the mask size suggested by DGtal for the grid step.
+struct BinomialConvolutionEstimator
+{
+  static const char* name() { return "bc"; }
+  static bool hasCurvature() { return true; }
+
+  template <typename TCurve>
+  static void estimate( const TCurve& curve, double h,
+                        std::vector<RealVector2D>& normals,
+                        std::vector<double>& curvatures )
+  {
+    typedef typename TCurve::PointsRange  Range;
+    typedef typename Range::ConstIterator Iterator;
+    typedef DGtal::BinomialConvolver<Iterator, double> Convolver;
+    typedef DGtal::TangentFromBinomialConvolverFunctor<Convolver, double>   TangentFunctor;
+    typedef DGtal::CurvatureFromBinomialConvolverFunctor<Convolver, double> CurvatureFunctor;
+    Range range = curve.getPointsRange();
+    DGtal::BinomialConvolverEstimator<Convolver, TangentFunctor>   tangentEstimator;
+    DGtal::BinomialConvolverEstimator<Convolver, CurvatureFunctor> curvatureEstimator;
+    tangentEstimator.init( h, range.begin(), range.end(), true );
+    curvatureEstimator.init( h, range.begin(), range.end(), true );
+    std::vector<RealVector2D> tangents;
+    tangents.reserve( curve.size() );
+    curvatures.clear();
+    curvatures.reserve( curve.size() );
+    tangentEstimator.eval( range.begin(), range.end(), std::back_inserter( tangents ) );
+    curvatureEstimator.eval( range.begin(), range.end(), std::back_inserter( curvatures ) );
+    tangentsToStepNormals( tangents, normals );
+    pointsToSteps( curvatures );
+  }
+};
+
+//------------------------------------------------------------------------------
+/// @return the names of the available estimators.
+inline std::vector<std::string> curveEstimatorNames()
+{
+  std::vector<std::string> names;
+  names.push_back( DCAEstimator::name() );
+  names.push_back( DSSTangentEstimator::name() );
+  names.push_back( LambdaMSTEstimator::name() );
+  names.push_back( BinomialConvolutionEstimator::name() );
+  return names;
+}
+
+/// Calls `visitor.template visit<Estimator>()` for the estimator called
+/// \a name, so that the runtime choice reaches a fully inlined instantiation.
+/// @return 'false' if there is no such estimator.
+template <typename TVisitor>
+bool visitCurveEstimator( const std::string& name, TVisitor& visitor )
+{
+  if      ( name == DCAEstimator::name() )
+    visitor.template visit<DCAEstimator>();
+  else if ( name == DSSTangentEstimator::name() )
+    visitor.template visit<DSSTangentEstimator>();
+  else if ( name == LambdaMSTEstimator::name() )
+    visitor.template visit<LambdaMSTEstimator>();
+  else if ( name == BinomialConvolutionEstimator::name() )
+    visitor.template visit<BinomialConvolutionEstimator>();
+  else
+    return false;
+  return true;
+}
+
+/// Visitor running an estimator on a curve.
+template <typename TCurve>
+struct CurveEstimatorVisitor
+{
+  const TCurve&              curve;
+  double                     h;
+  std::vector<RealVector2D>& normals;
+  std::vector<double>&       curvatures;
+
+  template <typename Estimator>
+  void visit() { Estimator::estimate( curve, h, normals, curvatures ); }
+};
+
+/// Runs the estimator called \a name on \a curve.
+/// @return 'false' if there is no such estimator.
+template <typename TCurve>
+bool estimateOnCurve( const std::string& name, const TCurve& curve, double h,
+                      std::vector<RealVector2D>& normals,
+                      std::vector<double>& curvatures )
+{
+  CurveEstimatorVisitor<TCurve> visitor = { curve, h, normals, curvatures };
+  return visitCurveEstimator( name, visitor );
+}
@@ -0,0 +1,339 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <thread>
+#include <functional>
+#include <fstream>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+/// Content-addressed on-disk cache of per-element fields, e.g. the
+/// normals or curvatures of each surfel.
+///
+/// An entry is a file named after the 64-bit key of the inputs of the
+/// computation (see FieldCache::Key). It holds a header, a table of named
+/// fields, then the values of each field as raw doubles aligned on 64
+/// bytes. A hit maps the file in memory: values are read from the mapping
+/// without any parsing. Entries are written to a temporary file then
+/// renamed, so that a reader never sees a partial entry. The layout uses
+/// the native byte order, the cache is meant to stay on one machine.
+class FieldCache
+{
+  static const char* magic() { return "DGFIELDS"; }
+  static const std::uint32_t VERSION = 1;
+
+  struct Header
+  {
+    char          magic[ 8 ];
+    std::uint32_t version;
+    std::uint32_t nbFields;
+    std::uint64_t key;
+    char          reserved[ 40 ];
+  };
+
+  struct TableEntry
+  {
+    char          name[ 40 ];
+    std::uint32_t dim;
+    std::uint32_t reserved;
+    std::uint64_t nbElements;
+    std::uint64_t offset; ///< from the beginning of the file
+  };
+
+public:
+  /// Hashes (FNV-1a, 64 bits) the inputs of a computation.
+  class Key
+  {
+  public:
+    Key() : myHash( 14695981039346656037ULL ) {}
+
+    Key& addBytes( const void* data, std::size_t n )
+    {
+      const unsigned char* p = static_cast<const unsigned char*>( data );
+      for ( std::size_t i = 0; i < n; ++i )
+        {
+          myHash ^= p[ i ];
+          myHash *= 1099511628211ULL;
+        }
+      return *this;
+    }
+    Key& add( const std::string& s )
+    {
+      add( std::int64_t( s.size() ) );
+      return addBytes( s.data(), s.size() );
+    }
+    Key& add( double x )       { return addBytes( &x, sizeof( x ) ); }
+    Key& add( std::int64_t i ) { return addBytes( &i, sizeof( i ) ); }
+    Key& add( const char* s )  { return add( std::string( s ) ); }
+
+    /// Adds the domain and the voxels of the binary image \a image, one
+    /// bit per voxel.
+    template <typename TImage>
+    Key& addImage( const TImage& image )
+    {
+      const auto lo = image.domain().lowerBound();
+      const auto hi = image.domain().upperBound();
+      for ( unsigned int k = 0; k < lo.size(); ++k )
+        add( std::int64_t( lo[ k ] ) ).add( std::int64_t( hi[ k ] ) );
+      std::uint64_t word = 0;
+      unsigned int  bit  = 0;
+      for ( auto it = image.begin(), ite = image.end(); it != ite; ++it )
+        {
+          if ( *it ) word |= std::uint64_t( 1 ) << bit;
+          if ( ++bit == 64 ) { addBytes( &word, sizeof( word ) ); word = 0; bit = 0; }
+        }
+      return addBytes( &word, sizeof( word ) );
+    }
+
+    std::uint64_t value() const { return myHash; }
+
+  private:
+    std::uint64_t myHash;
+  };
+
+  /// Fields to store: each one has a name, a dimension (e.g. 3 for
+  /// normals) and a value per element.
+  class Fields
+  {
+  public:
+    struct Field
+    {
+      std::string         name;
+      unsigned int        dim;
+      std::vector<double> values;
+    };
+
+    Fields& addScalars( const std::string& name, const std::vector<double>& values )
+    {
+      Field f = { name, 1, values };
+      myFields.push_back( f );
+      return *this;
+    }
+
+    /// Adds a field of fixed-size vectors (e.g. SH3::RealVectors).
+    template <typename TVectors>
+    Fields& addVectors( const std::string& name, const TVectors& vectors )
+    {
+      Field f = { name, vectors.empty() ? 0u : (unsigned int) vectors[ 0 ].size(), {} };
+      f.values.reserve( vectors.size() * f.dim );
+      for ( const auto& v : vectors )
+        for ( unsigned int k = 0; k < f.dim; ++k ) f.values.push_back( v[ k ] );
+      myFields.push_back( f );
+      return *this;
+    }
+
+    const std::vector<Field>& fields() const { return myFields; }
+
+  private:
+    std::vector<Field> myFields;
+  };
+
+  /// A read-only view on the values of a field of a mapped entry.
+  struct FieldView
+  {
+    const double* data;
+    std::size_t   size; ///< number of elements
+    unsigned int  dim;  ///< number of values per element
+  };
+
+  /// A memory-mapped entry.
+  class Entry
+  {
+  public:
+    ~Entry()
+    {
+#ifndef _WIN32
+      if ( myData != nullptr ) munmap( const_cast<char*>( myData ), mySize );
+#endif
+    }
+
+    /// @return 'true' if the entry has field \a name.
+    bool has( const std::string& name ) const { return find( name ) != nullptr; }
+
+    /// @return the values of field \a name (an empty view if none).
+    FieldView field( const std::string& name ) const
+    {
+      const TableEntry* t = find( name );
+      FieldView v = { nullptr, 0, 0 };
+      if ( t == nullptr ) return v;
+      v.data = reinterpret_cast<const double*>( myData + t->offset );
+      v.size = t->nbElements;
+      v.dim  = t->dim;
+      return v;
+    }
+
+    /// @return the scalars of field \a name.
+    std::vector<double> scalars( const std::string& name ) const
+    {
+      const FieldView v = field( name );
+      return std::vector<double>( v.data, v.data + v.size * v.dim );
+    }
+
+    /// @return the vectors of field \a name (e.g. SH3::RealVectors).
+    template <typename TVectors>
+    TVectors vectors( const std::string& name ) const
+    {
+      typedef typename TVectors::value_type Vector;
+      const FieldView v = field( name );
+      TVectors result( v.size );
+      for ( std::size_t i = 0; i < v.size; ++i )
+        {
+          Vector& x = result[ i ];
+          for ( unsigned int k = 0; k < v.dim && k < x.size(); ++k )
+            x[ k ] = v.data[ i * v.dim + k ];
+        }
+      return result;
+    }
+
+  private:
+    friend class FieldCache;
+    const char* myData = nullptr;
+    std::size_t mySize = 0;
+#ifdef _WIN32
+    std::vector<char> myBuffer; // no mmap: the file is read at once
+#endif
+
+    const TableEntry* find( const std::string& name ) const
+    {
+      const Header* h = reinterpret_cast<const Header*>( myData );
+      const TableEntry* t = reinterpret_cast<const TableEntry*>( myData + sizeof( Header ) );
+      for ( std::uint32_t i = 0; i < h->nbFields; ++i )
+        if ( name == t[ i ].name ) return t + i;
+      return nullptr;
+    }
+  };
+
+  /// Uses (and creates if needed) the directory \a directory.
+  explicit FieldCache( const std::string& directory )
+    : myDirectory( directory )
+  {
+#ifdef _WIN32
+    _mkdir( directory.c_str() );
+#else
+    mkdir( directory.c_str(), 0755 );
+#endif
+  }
+
+  /// @return the entry of key \a key, or null if there is no valid one.
+  std::unique_ptr<Entry> find( std::uint64_t key ) const
+  {
+    std::unique_ptr<Entry> entry( new Entry );
+    const std::string filename = path( key );
+#ifdef _WIN32
+    std::ifstream input( filename.c_str(), std::ios::binary | std::ios::ate );
+    if ( ! input ) return nullptr;
+    entry->myBuffer.resize( std::size_t( input.tellg() ) );
+    input.seekg( 0 );
+    input.read( entry->myBuffer.data(), entry->myBuffer.size() );
+    if ( ! input ) return nullptr;
+    entry->myData = entry->myBuffer.data();
+    entry->mySize = entry->myBuffer.size();
+#else
+    const int fd = open( filename.c_str(), O_RDONLY );
+    if ( fd < 0 ) return nullptr;
+    struct stat st;
+    if ( fstat( fd, &st ) != 0 || st.st_size == 0 ) { close( fd ); return nullptr; }
+    void* data = mmap( nullptr, std::size_t( st.st_size ), PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if ( data == MAP_FAILED ) return nullptr;
+    entry->myData = static_cast<const char*>( data );
+    entry->mySize = std::size_t( st.st_size );
+#endif
+    if ( ! isValid( *entry, key ) ) return nullptr;
+    return entry;
+  }
+
+  /// Stores \a fields as the entry of key \a key.
+  /// @return 'false' if the entry could not be written.
+  bool store( std::uint64_t key, const Fields& fields ) const
+  {
+    const auto& F = fields.fields();
+    Header header;
+    std::memset( &header, 0, sizeof( header ) );
+    std::memcpy( header.magic, magic(), sizeof( header.magic ) );
+    header.version  = VERSION;
+    header.nbFields = std::uint32_t( F.size() );
+    header.key      = key;
+    std::vector<TableEntry> table( F.size() );
+    std::uint64_t offset = align( sizeof( Header ) + F.size() * sizeof( TableEntry ) );
+    for ( std::size_t i = 0; i < F.size(); ++i )
+      {
+        TableEntry& t = table[ i ];
+        std::memset( &t, 0, sizeof( t ) );
+        std::strncpy( t.name, F[ i ].name.c_str(), sizeof( t.name ) - 1 );
+        t.dim        = F[ i ].dim;
+        t.nbElements = F[ i ].dim == 0 ? 0 : F[ i ].values.size() / F[ i ].dim;
+        t.offset     = offset;
+        offset       = align( offset + F[ i ].values.size() * sizeof( double ) );
+      }
+    const std::string filename = path( key );
+    const std::string tmp = filename + ".tmp"
+      + std::to_string( std::hash<std::thread::id>()( std::this_thread::get_id() ) );
+    {
+      std::ofstream output( tmp.c_str(), std::ios::binary );
+      output.write( reinterpret_cast<const char*>( &header ), sizeof( header ) );
+      output.write( reinterpret_cast<const char*>( table.data() ),
+                    table.size() * sizeof( TableEntry ) );
+      std::uint64_t written = sizeof( Header ) + table.size() * sizeof( TableEntry );
+      for ( std::size_t i = 0; i < F.size(); ++i )
+        {
+          for ( ; written < table[ i ].offset; ++written ) output.put( 0 );
+          output.write( reinterpret_cast<const char*>( F[ i ].values.data() ),
+                        F[ i ].values.size() * sizeof( double ) );
+          written += F[ i ].values.size() * sizeof( double );
+        }
+      if ( ! output ) { std::remove( tmp.c_str() ); return false; }
+    }
+    if ( std::rename( tmp.c_str(), filename.c_str() ) != 0 )
+      {
+        std::remove( tmp.c_str() );
+        return false;
+      }
+    return true;
+  }
+
+  /// @return the file of the entry of key \a key.
+  std::string path( std::uint64_t key ) const
+  {
+    char name[ 32 ];
+    std::snprintf( name, sizeof( name ), "%016llx.fields", (unsigned long long) key );
+    return myDirectory + "/" + name;
+  }
+
+private:
+  std::string myDirectory;
+
+  static std::uint64_t align( std::uint64_t offset )
+  {
+    return ( offset + 63 ) & ~std::uint64_t( 63 );
+  }
+
+  static bool isValid( const Entry& e, std::uint64_t key )
+  {
+    if ( e.mySize < sizeof( Header ) ) return false;
+    const Header* h = reinterpret_cast<const Header*>( e.myData );
+    if ( std::memcmp( h->magic, magic(), sizeof( h->magic ) ) != 0
+         || h->version != VERSION || h->key != key ) return false;
+    if ( e.mySize < sizeof( Header ) + h->nbFields * sizeof( TableEntry ) ) return false;
+    const TableEntry* t = reinterpret_cast<const TableEntry*>( e.myData + sizeof( Header ) );
+    for ( std::uint32_t i = 0; i < h->nbFields; ++i )
+      if ( t[ i ].name[ sizeof( t[ i ].name ) - 1 ] != 0
+           || t[ i ].offset % 64 != 0
+           || t[ i ].offset + t[ i ].nbElements * t[ i ].dim * sizeof( double ) > e.mySize )
+        return false;
+    return true;
+  }
+};
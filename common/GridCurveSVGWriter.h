@@ -0,0 +1,155 @@
+#pragma once
+
+#include <fstream>
+#include <string>
+#include <stdexcept>
+#include <cstdlib>
+#include <algorithm>
+#include <iterator>
+
+/// Streams grid curves to an SVG file, one \c path element per curve.
+///
+/// Contrary to `board << gridcurve`, no shape is stored in memory: every
+/// curve is written as soon as it is added. Runs of colinear steps are
+/// merged into a single segment and, when a positive \a tolerance is given,
+/// corners closer than \a tolerance SVG units to the last emitted vertex are
+/// dropped (decimation to screen resolution).
+///
+/// @tparam TPoint the type of digital points (e.g. Z2i::Point).
+template <typename TPoint>
+class GridCurveSVGWriter
+{
+public:
+  typedef TPoint Point;
+
+  /// Opens \a filename and writes the SVG header.
+  /// @param lowerBound the lower bound of the drawn domain.
+  /// @param upperBound the upper bound of the drawn domain.
+  /// @param scale the number of SVG units per grid unit.
+  /// @param tolerance the decimation tolerance in SVG units (0 keeps every corner).
+  GridCurveSVGWriter( const std::string& filename,
+                      const Point& lowerBound, const Point& upperBound,
+                      double scale = 1.0, double tolerance = 0.0 )
+    : myLower( lowerBound ), myUpper( upperBound ),
+      myScale( scale ), myTolerance( tolerance ),
+      myNbCurves( 0 ), myNbVertices( 0 )
+  {
+    myOut.open( filename.c_str() );
+    if ( ! myOut )
+      throw std::runtime_error( "Unable to open " + filename );
+    const double w = ( myUpper[ 0 ] - myLower[ 0 ] ) * myScale;
+    const double h = ( myUpper[ 1 ] - myLower[ 1 ] ) * myScale;
+    myOut << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+          << "<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\""
+          << " width=\"" << w << "\" height=\"" << h << "\""
+          << " viewBox=\"0 0 " << w << " " << h << "\">\n";
+  }
+
+  ~GridCurveSVGWriter() { close(); }
+
+  /// Writes the SVG footer and closes the file.
+  void close()
+  {
+    if ( ! myOut.is_open() ) return;
+    myOut << "</svg>\n";
+    myOut.close();
+  }
+
+  /// Writes the curve given by the points [itb,ite) as one path.
+  /// @param closed when 'true', the last point is linked to the first one.
+  /// @param color the stroke color.
+  /// @param width the stroke width in SVG units.
+  template <typename TIterator>
+  void addCurve( TIterator itb, TIterator ite, bool closed = true,
+                 const std::string& color = "red", double width = 1.0 )
+  {
+    if ( itb == ite ) return;
+    myOut << "<path fill=\"none\" stroke=\"" << color
+          << "\" stroke-width=\"" << width << "\" d=\"";
+    Point first = *itb;
+    Point last  = first; // last emitted vertex
+    Point prev  = first;
+    emit( 'M', first );
+    TIterator it = itb;
+    ++it;
+    if ( it != ite )
+      {
+        Point dir = *it - prev;
+        for ( ; it != ite; ++it )
+          {
+            const Point cur = *it;
+            const Point d   = cur - prev;
+            if ( d != dir ) // 'prev' is a corner
+              {
+                if ( farEnough( last, prev ) )
+                  {
+                    emit( 'L', prev );
+                    last = prev;
+                  }
+                dir = d;
+              }
+            prev = cur;
+          }
+        if ( prev != last ) emit( 'L', prev );
+      }
+    if ( closed ) myOut << " Z";
+    myOut << "\"/>\n";
+    ++myNbCurves;
+  }
+
+  /// @return the number of curves written so far.
+  std::size_t nbCurves() const { return myNbCurves; }
+
+  /// @return the number of path vertices written so far.
+  std::size_t nbVertices() const { return myNbVertices; }
+
+protected:
+  std::ofstream myOut;
+  Point         myLower;
+  Point         myUpper;
+  double        myScale;
+  double        myTolerance;
+  std::size_t   myNbCurves;
+  std::size_t   myNbVertices;
+
+  bool farEnough( const Point& p, const Point& q ) const
+  {
+    if ( myTolerance <= 0.0 ) return true;
+    const double dx = std::abs( (double) ( p[ 0 ] - q[ 0 ] ) ) * myScale;
+    const double dy = std::abs( (double) ( p[ 1 ] - q[ 1 ] ) ) * myScale;
+    return std::max( dx, dy ) >= myTolerance;
+  }
+
+  void emit( char command, const Point& p )
+  {
+    // SVG y-axis points downward.
+    myOut << command << ( p[ 0 ] - myLower[ 0 ] ) * myScale
+          << ' '     << ( myUpper[ 1 ] - p[ 1 ] ) * myScale << ' ';
+    ++myNbVertices;
+  }
+};
+
+/// Saves the closed curve given by the points [itb,ite) into \a filename
+/// as a single SVG path. The drawn domain is the bounding box of the points.
+/// @param scale the number of SVG units per grid unit.
+/// @param tolerance the decimation tolerance in SVG units (0 keeps every corner).
+template <typename TIterator>
+void saveGridCurveSVG( TIterator itb, TIterator ite,
+                       const std::string& filename,
+                       double scale = 1.0, double tolerance = 0.0 )
+{
+  typedef typename std::iterator_traits<TIterator>::value_type Point;
+  if ( itb == ite ) return;
+  // First pass: bounding box (nothing is stored).
+  Point lower = *itb;
+  Point upper = *itb;
+  for ( TIterator it = itb; it != ite; ++it )
+    {
+      lower = lower.inf( *it );
+      upper = upper.sup( *it );
+    }
+  const Point margin = Point::diagonal( 1 );
+  GridCurveSVGWriter<Point> writer( filename, lower - margin, upper + margin,
+                                    scale, tolerance );
+  writer.addCurve( itb, ite, true );
+}
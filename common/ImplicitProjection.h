@@ -0,0 +1,132 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <cmath>
+#include <cstddef>
+
+#include "DGtal/base/Common.h"
+
+#include "common/Parallel.h"
+#include "common/CompiledPolynomial.h"
+
+/// Statistics of a projection onto an implicit surface.
+struct ProjectionStatistics
+{
+  std::size_t nbPoints      = 0;
+  std::size_t nbConverged   = 0;   ///< points with |f| below the accuracy
+  std::size_t nbIterations  = 0;   ///< total number of Newton steps
+  std::size_t maxIterations = 0;   ///< largest number of steps of a point
+  double      maxResidual   = 0.0; ///< largest final |f|
+  double      time          = 0.0; ///< in ms
+};
+
+/// Projects \a points onto the zero level set of \a P, as
+/// ShortcutsGeometry::getPositions does with the shape of the same
+/// polynomial, with the parameters "projectionMaxIter",
+/// "projectionAccuracy" and "projectionGamma".
+///
+/// Each point moves by damped Newton steps x -= gamma f(x) grad f(x) /
+/// |grad f(x)|^2 until |f(x)| < accuracy. Points are handled in batches
+/// of 64 on \a nbThreads threads: each step evaluates f and its gradient
+/// on the whole batch at once (CompiledPolynomial3::evalWithGradient),
+/// and converged points leave the batch.
+///
+/// @tparam TPoints a vector of 3D real points (e.g. SH3::RealPoints).
+/// @param stats if not null, receives the convergence statistics.
+/// @param nbThreads the number of threads (0 means all cores).
+/// @param check if not empty, called before each chunk of batches: it
+/// may throw to stop the projection (e.g. BackgroundWorker::Token::check).
+template <typename TPoints>
+TPoints projectOnImplicitSurface( const CompiledPolynomial3& P,
+                                  const TPoints& points,
+                                  const DGtal::Parameters& params,
+                                  ProjectionStatistics* stats = nullptr,
+                                  unsigned int nbThreads = 0,
+                                  const std::function<void()>& check = nullptr )
+{
+  typedef typename TPoints::value_type RealPoint;
+  const int    maxIter  = params[ "projectionMaxIter" ].as<int>();
+  const double accuracy = params[ "projectionAccuracy" ].as<double>();
+  const double gamma    = params[ "projectionGamma" ].as<double>();
+  const std::size_t batch = 64;
+  const std::size_t nbBatches = ( points.size() + batch - 1 ) / batch;
+
+  auto start = std::chrono::steady_clock::now();
+  TPoints projections( points );
+  // Per batch statistics, gathered in order afterwards.
+  std::vector<ProjectionStatistics> partial( nbBatches );
+  // Tables of powers of each thread, reused by all its Newton steps.
+  if ( nbThreads == 0 ) nbThreads = defaultNumberOfThreads();
+  std::vector<CompiledPolynomial3::PowerTables> threadTables( nbThreads );
+  parallelForChunks( nbBatches, 16, [&] ( std::size_t cb, std::size_t ce, unsigned int thread )
+    {
+      if ( check ) check();
+      for ( std::size_t c = cb; c < ce; ++c )
+        {
+          const std::size_t b = c * batch;
+          const std::size_t n = std::min( points.size(), b + batch ) - b;
+          double x[ batch ], y[ batch ], z[ batch ];
+          double f[ batch ], gx[ batch ], gy[ batch ], gz[ batch ];
+          std::size_t active[ batch ], steps[ batch ];
+          CompiledPolynomial3::PowerTables& tables = threadTables[ thread ];
+          for ( std::size_t t = 0; t < n; ++t )
+            {
+              x[ t ] = points[ b + t ][ 0 ];
+              y[ t ] = points[ b + t ][ 1 ];
+              z[ t ] = points[ b + t ][ 2 ];
+              active[ t ] = t;
+              steps[ t ]  = 0;
+            }
+          ProjectionStatistics& S = partial[ c ];
+          std::size_t m = n; // active points are x[0..m), y[0..m), z[0..m)
+          for ( int it = 0; m > 0; ++it )
+            {
+              P.evalWithGradient( x, y, z, m, f, gx, gy, gz, tables );
+              std::size_t k = 0;
+              for ( std::size_t t = 0; t < m; ++t )
+                {
+                  const double g2 = gx[ t ] * gx[ t ] + gy[ t ] * gy[ t ] + gz[ t ] * gz[ t ];
+                  const bool converged = std::abs( f[ t ] ) < accuracy;
+                  if ( converged || it == maxIter || g2 == 0.0 )
+                    {
+                      // Leaves the batch.
+                      const std::size_t i = b + active[ t ];
+                      projections[ i ] = RealPoint( x[ t ], y[ t ], z[ t ] );
+                      S.nbConverged  += converged ? 1 : 0;
+                      S.nbIterations += steps[ t ];
+                      S.maxIterations = std::max( S.maxIterations, steps[ t ] );
+                      S.maxResidual   = std::max( S.maxResidual, std::abs( f[ t ] ) );
+                      continue;
+                    }
+                  const double s = gamma * f[ t ] / g2;
+                  x[ k ] = x[ t ] - s * gx[ t ];
+                  y[ k ] = y[ t ] - s * gy[ t ];
+                  z[ k ] = z[ t ] - s * gz[ t ];
+                  active[ k ] = active[ t ];
+                  steps[ k ]  = steps[ t ] + 1;
+                  ++k;
+                }
+              m = k;
+            }
+        }
+    }, nbThreads );
+  if ( stats != nullptr )
+    {
+      ProjectionStatistics S;
+      S.nbPoints = points.size();
+      for ( const auto& s : partial )
+        {
+          S.nbConverged  += s.nbConverged;
+          S.nbIterations += s.nbIterations;
+          S.maxIterations = std::max( S.maxIterations, s.maxIterations );
+          S.maxResidual   = std::max( S.maxResidual, s.maxResidual );
+        }
+      auto end = std::chrono::steady_clock::now();
+      S.time = std::chrono::duration<double, std::milli>( end - start ).count();
+      *stats = S;
+    }
+  return projections;
+}
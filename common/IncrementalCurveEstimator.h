@@ -0,0 +1,183 @@
+#pragma once
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include <cstddef>
+
+#include "DGtal/base/Common.h"
+#include "DGtal/base/Circulator.h"
+#include "DGtal/geometry/curves/StabbingCircleComputer.h"
+#include "DGtal/geometry/curves/SegmentComputerUtils.h"
+#include "DGtal/geometry/curves/estimation/SegmentComputerEstimators.h"
+
+#include "common/ChainCodeCurve.h"
+
+/// Normal and curvature estimation (most-centered maximal DCA, as in the
+/// 2D practical) on a closed grid curve that is edited locally.
+///
+/// For each step i, the estimator keeps its estimates and its reach, i.e.
+/// how far a digital circular arc containing i may extend backward and
+/// forward. Since maximality only depends on a segment and its two
+/// neighbors, and since sub-segments of segments are segments, the
+/// maximal segments around a step whose reach stays two steps away from
+/// an edited span are unchanged, and so are its estimates. After an edit,
+/// only the steps whose reach meets the edited span are re-estimated:
+/// the cost depends on the size of the edit and on the length of the
+/// segments, not on the length of the curve (apart from the memmove of the
+/// per-step arrays).
+///
+/// @tparam TKSpace a 2D Khalimsky space (e.g. Z2i::KSpace).
+template <typename TKSpace>
+class IncrementalCurveEstimator
+{
+public:
+  typedef TKSpace                                   KSpace;
+  typedef typename KSpace::Point                    Point;
+  typedef typename KSpace::Vector                   Vector;
+  typedef typename KSpace::Space::RealVector        RealVector;
+  typedef std::pair<Point,Point>                    IncidentPoints;
+  typedef std::size_t                               Index;
+  typedef std::vector<IncidentPoints>               Storage;
+  typedef typename Storage::const_iterator          ConstIterator;
+  typedef DGtal::Circulator<ConstIterator>          ConstCirculator;
+  typedef DGtal::StabbingCircleComputer<ConstCirculator>          SegmentComputer;
+  typedef DGtal::CurvatureFromDCAEstimator<SegmentComputer,false> CurvatureFunctor;
+  typedef DGtal::NormalFromDCAEstimator<SegmentComputer>          NormalFunctor;
+
+  /// @param K the Khalimsky space of the curve.
+  /// @param h the grid step.
+  IncrementalCurveEstimator( const KSpace& K, double h )
+    : myH( h ), myMaxReach( 0 ),
+      myInnerIsLeft( ChainCodeCurve<KSpace>::gridCurveInnerIsLeft( K ) ) {}
+
+  /// Estimates everything on the closed curve given by \a points
+  /// (4-connected pointels, as given to GridCurve::initFromVector).
+  void init( const std::vector<Point>& points )
+  {
+    myPoints = points;
+    if ( myPoints.size() > 1 && myPoints.front() == myPoints.back() )
+      myPoints.pop_back();
+    const Index n = myPoints.size();
+    myPairs.resize( n );
+    for ( Index i = 0; i < n; ++i )
+      myPairs[ i ] = incidentPoints( myPoints[ i ], myPoints[ ( i + 1 ) % n ] );
+    myCurvatures.assign( n, 0.0 );
+    myNormals.assign( n, RealVector() );
+    myBack.assign( n, 0 );
+    myFront.assign( n, 0 );
+    myMaxReach = 0;
+    for ( Index i = 0; i < n; ++i ) estimate( i );
+  }
+
+  /// Replaces the points [first,last) by \a newPoints and re-estimates
+  /// the steps whose estimates may have changed.
+  /// @pre 1 <= first <= last < size(), and the new points keep the curve
+  /// 4-connected.
+  /// @return the number of re-estimated steps.
+  Index replace( Index first, Index last, const std::vector<Point>& newPoints )
+  {
+    const Index n = myPoints.size();
+    if ( first < 1 || first > last || last >= n )
+      throw std::out_of_range( "IncrementalCurveEstimator::replace" );
+    myPoints.erase( myPoints.begin() + first, myPoints.begin() + last );
+    myPoints.insert( myPoints.begin() + first, newPoints.begin(), newPoints.end() );
+
+    // Steps [first-1, last) are replaced by steps [first-1, e1).
+    const Index e0 = first - 1;
+    const Index e1 = first + newPoints.size();
+    std::vector<IncidentPoints> pairs;
+    for ( Index i = e0; i < e1; ++i )
+      pairs.push_back( incidentPoints( myPoints[ i ], myPoints[ i + 1 ] ) );
+    replaceRange( myPairs, e0, last, pairs );
+    replaceRange( myCurvatures, e0, last, std::vector<double>( pairs.size(), 0.0 ) );
+    replaceRange( myNormals, e0, last, std::vector<RealVector>( pairs.size() ) );
+    replaceRange( myBack, e0, last, std::vector<Index>( pairs.size(), 0 ) );
+    replaceRange( myFront, e0, last, std::vector<Index>( pairs.size(), 0 ) );
+
+    // Invalidated steps: new ones and those whose reach meets the
+    // edited span extended by two steps.
+    const Index m  = myPairs.size();
+    const Index xs = ( e0 + m - 2 ) % m;
+    const Index xl = std::min( m, e1 - e0 + 4 );
+    std::vector<Index> invalid;
+    const Index nbCandidates = std::min( m, xl + 2 * myMaxReach );
+    for ( Index k = 0; k < nbCandidates; ++k )
+      {
+        const Index j = ( xs + m - myMaxReach % m + k ) % m;
+        const bool isNew = ( j + m - e0 ) % m < e1 - e0;
+        const Index s  = ( j + m - myBack[ j ] ) % m;
+        const Index ls = myBack[ j ] + myFront[ j ] + 1;
+        if ( isNew || ( xs + m - s ) % m < ls || ( s + m - xs ) % m < xl )
+          invalid.push_back( j );
+      }
+    for ( Index j : invalid ) estimate( j );
+    return invalid.size();
+  }
+
+  /// @return the number of steps.
+  Index size() const { return myPairs.size(); }
+  /// @return the points of the curve.
+  const std::vector<Point>& points() const { return myPoints; }
+  /// @return the curvature estimated at each step.
+  const std::vector<double>& curvatures() const { return myCurvatures; }
+  /// @return the normal estimated at each step.
+  const std::vector<RealVector>& normals() const { return myNormals; }
+
+protected:
+  double                  myH;
+  Index                   myMaxReach;
+  bool                    myInnerIsLeft;
+  std::vector<Point>      myPoints;
+  Storage                 myPairs;
+  std::vector<double>     myCurvatures;
+  std::vector<RealVector> myNormals;
+  std::vector<Index>      myBack;
+  std::vector<Index>      myFront;
+
+  IncidentPoints incidentPoints( const Point& p, const Point& q ) const
+  {
+    return ChainCodeCurve<KSpace>::incidentPoints
+      ( p, ChainCodeCurve<KSpace>::toCode( q - p ), myInnerIsLeft );
+  }
+
+  template <typename T>
+  static void replaceRange( std::vector<T>& v, Index b, Index e,
+                            const std::vector<T>& values )
+  {
+    v.erase( v.begin() + b, v.begin() + e );
+    v.insert( v.begin() + b, values.begin(), values.end() );
+  }
+
+  /// Computes the reach and the estimates of step \a i.
+  void estimate( Index i )
+  {
+    const Index n = myPairs.size();
+    const ConstCirculator c( myPairs.begin(), myPairs.begin(), myPairs.end() );
+    const ConstCirculator it( myPairs.begin() + i, myPairs.begin(), myPairs.end() );
+
+    // Reach: longest arcs ending and starting at i.
+    SegmentComputer sc;
+    sc.init( it );
+    Index back = 0, front = 0;
+    while ( back + 1 < n && sc.isExtendableBack() )  { sc.extendBack();  ++back; }
+    sc.init( it );
+    while ( front + 1 < n && sc.isExtendableFront() ) { sc.extendFront(); ++front; }
+    myBack[ i ]  = back;
+    myFront[ i ] = front;
+    myMaxReach   = std::max( myMaxReach, std::max( back, front ) );
+
+    // Estimates from the most centered maximal segment.
+    SegmentComputer msc;
+    DGtal::mostCenteredMaximalSegment( msc, it, c, c );
+    CurvatureFunctor cf;
+    cf.init( myH, c, c );
+    cf.attach( msc );
+    myCurvatures[ i ] = cf.eval( it );
+    NormalFunctor nf;
+    nf.init( myH, c, c );
+    nf.attach( msc );
+    myNormals[ i ] = nf.eval( it );
+  }
+};
@@ -0,0 +1,172 @@
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <utility>
+#include <cstdint>
+#include <cstddef>
+
+#include "common/Parallel.h"
+
+/// Non-manifold edges and vertices of a polygonal mesh.
+struct ManifoldReport
+{
+  typedef std::size_t Index;
+  std::size_t nbEdges         = 0;
+  std::size_t nbBoundaryEdges = 0; ///< edges of a single face
+  std::vector< std::pair<Index,Index> > nonManifoldEdges;    ///< edges of more than two faces, sorted
+  std::vector<Index>                    nonManifoldVertices; ///< sorted
+
+  /// @return 'true' if every edge has at most two faces and the faces
+  /// around every vertex form a single fan.
+  bool isManifold() const
+  {
+    return nonManifoldEdges.empty() && nonManifoldVertices.empty();
+  }
+};
+
+/// Computes the non-manifold edges and vertices of the mesh \a faces
+/// (e.g. QuadMesh::quads) with \a nbVertices vertices, in linear time on
+/// \a nbThreads threads.
+///
+/// Edges are counted in a flat open-addressing hash table of 64-bit edge
+/// keys, filled by all threads at once with compare-and-swap. A vertex
+/// is non-manifold if one of its edges is, or if its faces do not form a
+/// single fan of faces glued along edges of exactly two faces.
+///
+/// @tparam TFaces a vector of faces, each a random access range of vertex
+/// indices (e.g. std::vector< std::array<std::size_t,4> >).
+template <typename TFaces>
+ManifoldReport checkManifoldness( const TFaces& faces, std::size_t nbVertices,
+                                  unsigned int nbThreads = 0 )
+{
+  typedef ManifoldReport::Index Index;
+  const std::uint64_t EMPTY = ~std::uint64_t( 0 );
+  ManifoldReport R;
+
+  // Hash table of at least twice as many slots as edges.
+  std::size_t nbCorners = 0;
+  for ( const auto& f : faces ) nbCorners += f.size();
+  std::size_t capacity = 16;
+  while ( capacity < 2 * nbCorners ) capacity *= 2;
+  const std::size_t mask = capacity - 1;
+  std::vector< std::atomic<std::uint64_t> > keys( capacity );
+  std::vector< std::atomic<std::uint32_t> > counts( capacity );
+  parallelFor( capacity, [&] ( std::size_t i )
+    {
+      keys[ i ].store( EMPTY, std::memory_order_relaxed );
+      counts[ i ].store( 0, std::memory_order_relaxed );
+    }, nbThreads, 4096 );
+
+  auto edgeKey = [] ( Index u, Index v ) -> std::uint64_t
+    {
+      if ( v < u ) std::swap( u, v );
+      return ( std::uint64_t( u ) << 32 ) | std::uint64_t( v );
+    };
+  auto hash = [mask] ( std::uint64_t k ) -> std::size_t
+    {
+      k ^= k >> 33; k *= 0xff51afd7ed558ccdULL; k ^= k >> 33;
+      return std::size_t( k ) & mask;
+    };
+  // @return the slot of edge key k (-1 if absent).
+  auto find = [&] ( std::uint64_t k ) -> std::size_t
+    {
+      for ( std::size_t h = hash( k ); ; h = ( h + 1 ) & mask )
+        {
+          const std::uint64_t cur = keys[ h ].load( std::memory_order_relaxed );
+          if ( cur == k )     return h;
+          if ( cur == EMPTY ) return std::size_t( -1 );
+        }
+    };
+
+  // Edge incidences, all faces at once.
+  parallelFor( faces.size(), [&] ( std::size_t i )
+    {
+      const auto& f = faces[ i ];
+      const std::size_t n = f.size();
+      for ( std::size_t c = 0; c < n; ++c )
+        {
+          const std::uint64_t k = edgeKey( f[ c ], f[ ( c + 1 ) % n ] );
+          for ( std::size_t h = hash( k ); ; h = ( h + 1 ) & mask )
+            {
+              std::uint64_t cur = keys[ h ].load( std::memory_order_relaxed );
+              if ( cur == EMPTY
+                   && keys[ h ].compare_exchange_strong( cur, k, std::memory_order_relaxed ) )
+                cur = k;
+              if ( cur == k ) { counts[ h ].fetch_add( 1, std::memory_order_relaxed ); break; }
+            }
+        }
+    }, nbThreads, 1024 );
+
+  // Boundary and non-manifold edges.
+  std::vector< std::pair<Index,Index> > edges;
+  for ( std::size_t h = 0; h < capacity; ++h )
+    {
+      const std::uint64_t k = keys[ h ].load( std::memory_order_relaxed );
+      if ( k == EMPTY ) continue;
+      const std::uint32_t n = counts[ h ].load( std::memory_order_relaxed );
+      R.nbEdges += 1;
+      R.nbBoundaryEdges += n == 1 ? 1 : 0;
+      if ( n > 2 ) edges.push_back( std::make_pair( Index( k >> 32 ), Index( k & 0xffffffffULL ) ) );
+    }
+  std::sort( edges.begin(), edges.end() );
+  R.nonManifoldEdges.swap( edges );
+
+  // Corners (face, index in face) around each vertex.
+  std::vector<std::size_t> start( nbVertices + 1, 0 );
+  for ( const auto& f : faces )
+    for ( std::size_t c = 0; c < f.size(); ++c ) ++start[ f[ c ] + 1 ];
+  for ( std::size_t v = 0; v < nbVertices; ++v ) start[ v + 1 ] += start[ v ];
+  std::vector< std::pair<std::size_t,std::size_t> > corners( start.back() );
+  {
+    std::vector<std::size_t> next( start.begin(), start.end() - 1 );
+    for ( std::size_t i = 0; i < faces.size(); ++i )
+      for ( std::size_t c = 0; c < faces[ i ].size(); ++c )
+        corners[ next[ faces[ i ][ c ] ]++ ] = std::make_pair( i, c );
+  }
+
+  // Fans around each vertex.
+  std::vector<unsigned char> nonManifold( nbVertices, 0 );
+  parallelForChunks( nbVertices, 1024, [&] ( std::size_t b, std::size_t e, unsigned int )
+    {
+      std::vector<std::size_t> label;
+      for ( std::size_t v = b; v < e; ++v )
+        {
+          const std::size_t k = start[ v + 1 ] - start[ v ];
+          const auto* C = corners.data() + start[ v ];
+          // The two neighbors of v in the face of corner j.
+          auto neighbor = [&] ( std::size_t j, int side ) -> Index
+            {
+              const auto& f = faces[ C[ j ].first ];
+              const std::size_t n = f.size();
+              return f[ ( C[ j ].second + ( side == 0 ? n - 1 : 1 ) ) % n ];
+            };
+          label.resize( k );
+          for ( std::size_t j = 0; j < k; ++j ) label[ j ] = j;
+          bool bad = false;
+          for ( std::size_t j = 0; j < k && ! bad; ++j )
+            for ( int side = 0; side < 2 && ! bad; ++side )
+              {
+                const Index w = neighbor( j, side );
+                const std::uint32_t n = counts[ find( edgeKey( v, w ) ) ].load( std::memory_order_relaxed );
+                if ( n > 2 ) bad = true;
+                if ( n != 2 ) continue;
+                // Glues the two faces of edge (v,w).
+                for ( std::size_t l = j + 1; l < k; ++l )
+                  if ( neighbor( l, 0 ) == w || neighbor( l, 1 ) == w )
+                    {
+                      const std::size_t from = label[ l ], to = label[ j ];
+                      if ( from != to )
+                        for ( auto& x : label ) if ( x == from ) x = to;
+                    }
+              }
+          for ( std::size_t j = 1; j < k && ! bad; ++j )
+            bad = label[ j ] != label[ 0 ];
+          nonManifold[ v ] = bad ? 1 : 0;
+        }
+    }, nbThreads );
+  for ( std::size_t v = 0; v < nbVertices; ++v )
+    if ( nonManifold[ v ] ) R.nonManifoldVertices.push_back( v );
+  return R;
+}
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <unordered_map>
+#include <cstddef>
+#include <cstdint>
+
+#include "DGtal/base/Common.h"
+
+#include "common/QuadMesh.h"
+
+/// Render mesh of a digital surface where runs of coplanar surfels are
+/// merged into maximal rectangles (greedy meshing), for display and
+/// export only: rectangles create T-junctions, so computations should use
+/// the QuadMesh of the same surfels.
+///
+/// Surfels are grouped by plane and orientation (and optionally by a
+/// label, e.g. a quantized value, so that only surfels of equal label are
+/// merged). In each group, surfels are sorted by rows; each rectangle
+/// grows from the first free surfel along its row, then row by row while
+/// the whole next row is free. Rectangles keep the orientation and the
+/// embedding of QuadMesh, and faceOfSurfel maps the surfels to them.
+///
+/// @tparam TRealPoint the type of positions (e.g. Z3i::RealPoint).
+template <typename TRealPoint>
+struct MergedQuadMesh
+{
+  typedef TRealPoint                  RealPoint;
+  typedef QuadMesh<RealPoint>         Mesh;
+  typedef typename Mesh::Index        Index;
+  typedef typename Mesh::Quad         Quad;
+
+  std::vector<Quad>      quads;        ///< vertex indices of each rectangle
+  std::vector<RealPoint> positions;    ///< position of each vertex
+  std::vector<Index>     faceOfSurfel; ///< rectangle of each surfel
+
+  /// Merges the surfels of \a surfels.
+  /// @param K the Khalimsky space of the surfels.
+  /// @param surfels a range of signed surfels (e.g. Shortcuts::SurfelRange).
+  /// @param h the gridstep.
+  /// @param labels if not null, one label per surfel: only surfels of
+  /// equal labels are merged.
+  template <typename TKSpace, typename TSurfelRange>
+  void init( const TKSpace& K, const TSurfelRange& surfels, double h = 1.0,
+             const std::vector<int>* labels = nullptr )
+  {
+    typedef typename TKSpace::Point Point;
+    quads.clear();
+    positions.clear();
+    faceOfSurfel.assign( surfels.size(), 0 );
+    // Plane, orientation, label and cell of each surfel.
+    std::vector<Cell> cells( surfels.size() );
+    for ( std::size_t n = 0; n < surfels.size(); ++n )
+      {
+        const Point c = K.sKCoords( surfels[ n ] );
+        const int   k = int( K.sOrthDir( surfels[ n ] ) );
+        Cell& C    = cells[ n ];
+        C.group    = { { k, c[ k ], K.sDirect( surfels[ n ], k ) ? 1 : 0,
+                         labels != nullptr ? (*labels)[ n ] : 0 } };
+        C.v        = ( c[ ( k + 2 ) % 3 ] - 1 ) / 2;
+        C.u        = ( c[ ( k + 1 ) % 3 ] - 1 ) / 2;
+        C.surfel   = n;
+      }
+    std::sort( cells.begin(), cells.end() );
+
+    std::unordered_map<std::uint64_t,Index> indices; // pointel -> vertex
+    std::unordered_map<std::uint64_t,std::size_t> cellOf; // (u,v) -> cell in group
+    std::vector<unsigned char> done( cells.size(), 0 );
+    for ( std::size_t b = 0; b < cells.size(); )
+      {
+        std::size_t e = b + 1;
+        while ( e < cells.size() && cells[ e ].group == cells[ b ].group ) ++e;
+        cellOf.clear();
+        for ( std::size_t c = b; c < e; ++c )
+          cellOf[ uvKey( cells[ c ].u, cells[ c ].v ) ] = c;
+        auto freeCell = [&] ( int u, int v ) -> std::size_t
+          {
+            auto it = cellOf.find( uvKey( u, v ) );
+            return ( it == cellOf.end() || done[ it->second ] ) ? std::size_t( -1 ) : it->second;
+          };
+        for ( std::size_t c = b; c < e; ++c )
+          {
+            if ( done[ c ] ) continue;
+            // Longest run of free cells along the row (consecutive once sorted).
+            const int u0 = cells[ c ].u, v0 = cells[ c ].v;
+            std::size_t last = c;
+            while ( last + 1 < e && ! done[ last + 1 ]
+                    && cells[ last + 1 ].v == v0 && cells[ last + 1 ].u == cells[ last ].u + 1 )
+              ++last;
+            const int u1 = cells[ last ].u;
+            // Following rows, as long as they are entirely free.
+            int v1 = v0;
+            for ( bool full = true; full; )
+              {
+                for ( int u = u0; u <= u1 && full; ++u )
+                  full = freeCell( u, v1 + 1 ) != std::size_t( -1 );
+                if ( full ) ++v1;
+              }
+            const Index f = quads.size();
+            for ( int v = v0; v <= v1; ++v )
+              for ( int u = u0; u <= u1; ++u )
+                {
+                  const std::size_t x = v == v0 ? c + std::size_t( u - u0 ) : freeCell( u, v );
+                  done[ x ] = 1;
+                  faceOfSurfel[ cells[ x ].surfel ] = f;
+                }
+            quads.push_back( rectangle<Point>( indices, cells[ c ].group, u0, v0, u1, v1, h ) );
+          }
+        b = e;
+      }
+  }
+
+  /// @return the mean over each rectangle of the per-surfel quantities
+  /// \a values (e.g. normals, which are then no longer unitary).
+  template <typename TValue>
+  std::vector<TValue> faceValues( const std::vector<TValue>& values ) const
+  {
+    std::vector<TValue>      sums( quads.size(), TValue() );
+    std::vector<std::size_t> counts( quads.size(), 0 );
+    for ( std::size_t n = 0; n < values.size(); ++n )
+      {
+        sums[ faceOfSurfel[ n ] ] += values[ n ];
+        counts[ faceOfSurfel[ n ] ] += 1;
+      }
+    for ( std::size_t f = 0; f < quads.size(); ++f )
+      if ( counts[ f ] > 1 ) sums[ f ] *= 1.0 / double( counts[ f ] );
+    return sums;
+  }
+
+  /// @return the minimum over each rectangle of the per-surfel scalars
+  /// \a values (e.g. flags, which a mean would turn into values that no
+  /// surfel has).
+  template <typename TScalar>
+  std::vector<TScalar> faceMin( const std::vector<TScalar>& values ) const
+  {
+    std::vector<TScalar>       mins( quads.size(), TScalar() );
+    std::vector<unsigned char> seen( quads.size(), 0 );
+    for ( std::size_t n = 0; n < values.size(); ++n )
+      {
+        const Index f = faceOfSurfel[ n ];
+        mins[ f ] = seen[ f ] ? std::min( mins[ f ], values[ n ] ) : values[ n ];
+        seen[ f ] = 1;
+      }
+    return mins;
+  }
+
+  /// @return the number of faces.
+  Index nbFaces() const { return quads.size(); }
+  /// @return the number of vertices.
+  Index nbVertices() const { return positions.size(); }
+
+protected:
+  /// A surfel in its group: (orthogonal direction, plane, direct, label)
+  /// and its cell (u,v) in the plane.
+  struct Cell
+  {
+    std::array<int,4> group;
+    int               v, u;
+    std::size_t       surfel;
+    bool operator<( const Cell& other ) const
+    {
+      if ( group != other.group ) return group < other.group;
+      if ( v != other.v )         return v < other.v;
+      return u < other.u;
+    }
+  };
+
+  static std::uint64_t uvKey( int u, int v )
+  {
+    return ( std::uint64_t( std::uint32_t( u ) ) << 32 ) | std::uint64_t( std::uint32_t( v ) );
+  }
+
+  /// @return the quad of cells [u0,u1]x[v0,v1] of \a group, oriented as
+  /// QuadMesh::corners.
+  template <typename Point>
+  Quad rectangle( std::unordered_map<std::uint64_t,Index>& indices,
+                  const std::array<int,4>& group,
+                  int u0, int v0, int u1, int v1, double h )
+  {
+    const int k = group[ 0 ], i = ( k + 1 ) % 3, j = ( k + 2 ) % 3;
+    const int ci[ 4 ] = { 2 * u0, 2 * u1 + 2, 2 * u1 + 2, 2 * u0 };
+    const int cj[ 4 ] = { 2 * v0, 2 * v0, 2 * v1 + 2, 2 * v1 + 2 };
+    const bool reversed = group[ 2 ] != 0;
+    Quad q;
+    for ( int c = 0; c < 4; ++c )
+      {
+        Point p;
+        p[ k ] = group[ 1 ];
+        p[ i ] = ci[ c ];
+        p[ j ] = cj[ c ];
+        const std::uint64_t key = Mesh::key( p );
+        auto it = indices.find( key );
+        if ( it == indices.end() )
+          {
+            it = indices.insert( std::make_pair( key, positions.size() ) ).first;
+            positions.push_back( Mesh::embed( p, h ) );
+          }
+        q[ reversed ? 3 - c : c ] = it->second;
+      }
+    return q;
+  }
+};
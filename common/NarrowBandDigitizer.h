@@ -0,0 +1,186 @@
+#pragma once
+
+#include <string>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <cstddef>
+#include <cmath>
+
+#include "DGtal/base/Common.h"
+#include "DGtal/helpers/StdDefs.h"
+#include "DGtal/helpers/Shortcuts.h"
+#include "DGtal/math/MPolynomial.h"
+#include "DGtal/io/readers/MPolynomialReader.h"
+
+#include "common/CompiledPolynomial.h"
+
+/// Narrow-band Gauss digitization of implicit polynomial shapes.
+///
+/// The polynomial is evaluated with interval arithmetic on the boxes of
+/// an octree over the digitization domain. A box whose interval does not
+/// contain 0 is entirely inside or outside and is filled at once; other
+/// boxes are subdivided down to a few voxels, whose centers are tested
+/// with the compiled polynomial (see CompiledPolynomial3). The resulting image is thus the
+/// same as SH3::makeBinaryImage (without noise), but the polynomial is
+/// evaluated only near its zero level set.
+
+/// A closed interval of reals.
+struct Interval
+{
+  double lo, hi;
+  Interval( double v = 0.0 ) : lo( v ), hi( v ) {}
+  Interval( double l, double h ) : lo( l ), hi( h ) {}
+};
+
+inline Interval operator+( const Interval& a, const Interval& b )
+{
+  return Interval( a.lo + b.lo, a.hi + b.hi );
+}
+
+inline Interval operator*( const Interval& a, const Interval& b )
+{
+  const double p1 = a.lo * b.lo, p2 = a.lo * b.hi;
+  const double p3 = a.hi * b.lo, p4 = a.hi * b.hi;
+  return Interval( std::min( std::min( p1, p2 ), std::min( p3, p4 ) ),
+                   std::max( std::max( p1, p2 ), std::max( p3, p4 ) ) );
+}
+
+/// Horner evaluation of a DGtal MPolynomial on a box. The outer variable
+/// is the first coordinate, as in ImplicitPolynomial3Shape::operator().
+template <int N>
+struct IntervalHorner
+{
+  template <typename TPolynomial>
+  static Interval eval( const TPolynomial& P, const Interval* X )
+  {
+    Interval r( 0.0 );
+    for ( int i = P.degree(); i >= 0; --i )
+      r = r * X[ 0 ] + IntervalHorner<N-1>::eval( P[ i ], X + 1 );
+    return r;
+  }
+};
+
+template <>
+struct IntervalHorner<0>
+{
+  template <typename TCoefficient>
+  static Interval eval( const TCoefficient& c, const Interval* )
+  {
+    return Interval( static_cast<double>( c ) );
+  }
+};
+
+/// Narrow-band digitizer of the implicit shape given by the parameter
+/// "polynomial" (a predefined name of SH3::getPolynomialList or an
+/// expression).
+class NarrowBandDigitizer
+{
+public:
+  typedef DGtal::Shortcuts<DGtal::Z3i::KSpace> SH;
+  typedef DGtal::MPolynomial<3,double>         Polynomial3;
+  typedef SH::Point                            Point;
+  typedef SH::RealPoint                        RealPoint;
+
+  /// @param params the parameters given to SH3::makeImplicitShape3D.
+  explicit NarrowBandDigitizer( const DGtal::Parameters& params )
+    : myNbEvaluations( 0 ), myNbFilledBoxes( 0 )
+  {
+    std::string poly_str = params[ "polynomial" ].as<std::string>();
+    auto PL = SH::getPolynomialList();
+    if ( PL.count( poly_str ) ) poly_str = PL[ poly_str ];
+    DGtal::MPolynomialReader<3,double> reader;
+    std::string::const_iterator iter
+      = reader.read( myPolynomial, poly_str.begin(), poly_str.end() );
+    if ( iter != poly_str.end() )
+      throw std::invalid_argument( "NarrowBandDigitizer: error reading polynomial " + poly_str );
+    myCompiled = CompiledPolynomial3( myPolynomial );
+  }
+
+  /// @return the binary image of the digitization \a dshape, as
+  /// SH3::makeBinaryImage( dshape, params ) without noise.
+  /// @param check if not empty, called before each octree box that is
+  /// subdivided: it may throw to stop the digitization (e.g.
+  /// BackgroundWorker::Token::check).
+  DGtal::CountedPtr<SH::BinaryImage>
+  makeBinaryImage( DGtal::CountedPtr<SH::DigitizedImplicitShape3D> dshape,
+                   const std::function<void()>& check = nullptr )
+  {
+    const SH::Domain domain = dshape->getDomain();
+    DGtal::CountedPtr<SH::BinaryImage> bimage( new SH::BinaryImage( domain ) );
+    myNbEvaluations = myNbFilledBoxes = 0;
+    const Point size = domain.upperBound() - domain.lowerBound() + Point::diagonal( 1 );
+    int s = 1;
+    while ( s < size[ 0 ] || s < size[ 1 ] || s < size[ 2 ] ) s *= 2;
+    subdivide( *dshape, *bimage, domain, domain.lowerBound(), s, check );
+    return bimage;
+  }
+
+  /// @return the compiled polynomial.
+  const CompiledPolynomial3& compiledPolynomial() const { return myCompiled; }
+
+  /// @return the number of voxels tested by the last digitization.
+  std::size_t nbEvaluations() const { return myNbEvaluations; }
+  /// @return the number of octree boxes filled at once.
+  std::size_t nbFilledBoxes() const { return myNbFilledBoxes; }
+
+protected:
+  Polynomial3         myPolynomial;
+  CompiledPolynomial3 myCompiled;
+  std::size_t myNbEvaluations;
+  std::size_t myNbFilledBoxes;
+
+  /// Below this size, boxes are tested voxel by voxel.
+  static const int leafSize = 4;
+
+  /// Digitizes the box of origin \a o and side \a s (clipped to \a domain).
+  void subdivide( const SH::DigitizedImplicitShape3D& dshape,
+                  SH::BinaryImage& image, const SH::Domain& domain,
+                  const Point& o, int s, const std::function<void()>& check )
+  {
+    const Point lo = o.sup( domain.lowerBound() );
+    const Point hi = ( o + Point::diagonal( s - 1 ) ).inf( domain.upperBound() );
+    if ( lo[ 0 ] > hi[ 0 ] || lo[ 1 ] > hi[ 1 ] || lo[ 2 ] > hi[ 2 ] ) return;
+    if ( s <= leafSize )
+      {
+        double values[ leafSize ];
+        const int n = hi[ 0 ] - lo[ 0 ] + 1;
+        for ( int z = lo[ 2 ]; z <= hi[ 2 ]; ++z )
+          for ( int y = lo[ 1 ]; y <= hi[ 1 ]; ++y )
+            {
+              const Point p( lo[ 0 ], y, z );
+              myCompiled.evalRow( dshape, p, n, values );
+              for ( int x = 0; x < n; ++x )
+                {
+                  const Point q = p + Point( x, 0, 0 );
+                  image.setValue( q, myCompiled.isInside( dshape, q, values[ x ] ) );
+                }
+            }
+        myNbEvaluations += SH::Domain( lo, hi ).size();
+        return;
+      }
+    // Interval of the polynomial on the box of the voxel centers.
+    const RealPoint a = dshape.embed( lo );
+    const RealPoint b = dshape.embed( hi );
+    Interval X[ 3 ];
+    for ( int k = 0; k < 3; ++k )
+      X[ k ] = Interval( std::min( a[ k ], b[ k ] ), std::max( a[ k ], b[ k ] ) );
+    const Interval F = IntervalHorner<3>::eval( myPolynomial, X );
+    // some slack for rounding errors
+    const double eps = 1e-9 * std::max( 1.0, std::max( fabs( F.lo ), fabs( F.hi ) ) );
+    if ( F.lo > eps || F.hi < -eps )
+      {
+        // the image is initialized to 'false'
+        if ( F.hi < 0.0 )
+          for ( auto p : SH::Domain( lo, hi ) )
+            image.setValue( p, true );
+        ++myNbFilledBoxes;
+        return;
+      }
+    if ( check ) check();
+    const int h = s / 2;
+    for ( int k = 0; k < 8; ++k )
+      subdivide( dshape, image, domain,
+                 o + Point( ( k & 1 ) ? h : 0, ( k & 2 ) ? h : 0, ( k & 4 ) ? h : 0 ), h, check );
+  }
+};
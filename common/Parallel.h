@@ -0,0 +1,69 @@
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <exception>
+#include <algorithm>
+#include <cstddef>
+
+/// @return the number of threads to use when none is specified.
+inline unsigned int defaultNumberOfThreads()
+{
+  const unsigned int n = std::thread::hardware_concurrency();
+  return n == 0 ? 1 : n;
+}
+
+/// Splits [0,n) into chunks of \a chunkSize indices that a pool of
+/// \a nbThreads workers grab dynamically, and calls
+/// `f( begin, end, threadIndex )` on each chunk. The calling thread is one
+/// of the workers. The first exception thrown by a worker is rethrown.
+///
+/// @param n the number of indices.
+/// @param chunkSize the number of indices handed out at once.
+/// @param f a functor `void( std::size_t, std::size_t, unsigned int )`.
+/// @param nbThreads the number of threads (0 means all cores).
+template <typename Functor>
+void parallelForChunks( std::size_t n, std::size_t chunkSize, const Functor& f,
+                        unsigned int nbThreads = 0 )
+{
+  if ( n == 0 ) return;
+  if ( nbThreads == 0 ) nbThreads = defaultNumberOfThreads();
+  chunkSize = std::max( chunkSize, std::size_t( 1 ) );
+  const std::size_t nbChunks = ( n + chunkSize - 1 ) / chunkSize;
+  nbThreads = (unsigned int) std::min( (std::size_t) nbThreads, nbChunks );
+
+  std::atomic<std::size_t> next( 0 );
+  std::exception_ptr       error;
+  std::mutex               errorMutex;
+  auto worker = [&] ( unsigned int t )
+    {
+      try {
+        for ( std::size_t c = next++; c < nbChunks; c = next++ )
+          f( c * chunkSize, std::min( n, ( c + 1 ) * chunkSize ), t );
+      } catch ( ... ) {
+        std::lock_guard<std::mutex> lock( errorMutex );
+        if ( ! error ) error = std::current_exception();
+        next = nbChunks; // stops the other workers
+      }
+    };
+  std::vector<std::thread> threads;
+  for ( unsigned int t = 1; t < nbThreads; ++t )
+    threads.push_back( std::thread( worker, t ) );
+  worker( 0 );
+  for ( auto& th : threads ) th.join();
+  if ( error ) std::rethrow_exception( error );
+}
+
+/// Calls `f( i )` for every i in [0,n) on \a nbThreads threads.
+/// @see parallelForChunks
+template <typename Functor>
+void parallelFor( std::size_t n, const Functor& f,
+                  unsigned int nbThreads = 0, std::size_t chunkSize = 1 )
+{
+  parallelForChunks( n, chunkSize,
+                     [&f] ( std::size_t b, std::size_t e, unsigned int )
+                     { for ( std::size_t i = b; i < e; ++i ) f( i ); },
+                     nbThreads );
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <cstddef>
+
+#include "DGtal/base/Common.h"
+#include "DGtal/helpers/StdDefs.h"
+#include "DGtal/helpers/Shortcuts.h"
+#include "DGtal/helpers/ShortcutsGeometry.h"
+
+#include "common/Parallel.h"
+
+/// Multithreaded integral invariant (II) estimation on a range of surfels.
+///
+/// The surfel range is cut into contiguous chunks that worker threads
+/// grab dynamically. Each worker runs the Shortcuts II estimator on its
+/// chunks, with its own copy of the parameters (and thus its own
+/// estimator and convolver). II quantities only depend on the ball
+/// around each surfel, so the result is identical to the sequential
+/// estimation. Chunks are kept large since the convolver is faster on
+/// runs of neighboring surfels.
+
+typedef DGtal::Shortcuts<DGtal::Z3i::KSpace>         IISH3;
+typedef DGtal::ShortcutsGeometry<DGtal::Z3i::KSpace> IISHG3;
+
+/// Calls `f( subrange, params )` on chunks of \a surfels in parallel and
+/// gathers the per-surfel results in \a result.
+/// @param f a functor returning one quantity per surfel of the subrange.
+/// @param nbThreads the number of threads (0 means all cores).
+/// @param chunkSize the number of surfels per chunk (0 means automatic).
+/// @param check if not empty, called before each chunk: it may throw to
+/// stop the estimation (e.g. BackgroundWorker::Token::check).
+template <typename TQuantities, typename Functor>
+void parallelSurfelEstimation( const IISH3::SurfelRange& surfels,
+                               const DGtal::Parameters& params,
+                               TQuantities& result,
+                               const Functor& f,
+                               unsigned int nbThreads = 0,
+                               std::size_t chunkSize  = 0,
+                               const std::function<void()>& check = nullptr )
+{
+  const std::size_t n = surfels.size();
+  if ( nbThreads == 0 ) nbThreads = defaultNumberOfThreads();
+  if ( chunkSize == 0 )
+    chunkSize = std::max( std::size_t( 256 ), n / ( 8 * nbThreads ) + 1 );
+  result.resize( n );
+  // Per-thread parameters, quiet since the trace is not thread-safe.
+  std::vector<DGtal::Parameters> threadParams( nbThreads, params );
+  for ( auto& p : threadParams ) p( "verbose", 0 );
+  parallelForChunks( n, chunkSize,
+                     [&] ( std::size_t b, std::size_t e, unsigned int t )
+                     {
+                       if ( check ) check();
+                       const IISH3::SurfelRange sub( surfels.begin() + b, surfels.begin() + e );
+                       const auto values = f( sub, threadParams[ t ] );
+                       std::copy( values.begin(), values.end(), result.begin() + b );
+                     }, nbThreads );
+}
+
+/// Parallel version of IISHG3::getIINormalVectors.
+/// @param check called before each chunk (see parallelSurfelEstimation).
+inline IISHG3::RealVectors
+parallelIINormalVectors( DGtal::CountedPtr<IISH3::BinaryImage> bimage,
+                         const IISH3::SurfelRange& surfels,
+                         const DGtal::Parameters& params,
+                         unsigned int nbThreads = 0,
+                         const std::function<void()>& check = nullptr )
+{
+  IISHG3::RealVectors result;
+  // CountedPtr is not thread-safe: workers only see the image itself.
+  const IISH3::BinaryImage& image = *bimage;
+  const IISH3::KSpace       K     = IISH3::getKSpace( bimage, params );
+  parallelSurfelEstimation
+    ( surfels, params, result,
+      [&image, &K] ( const IISH3::SurfelRange& sub, const DGtal::Parameters& p )
+      { return IISHG3::getIINormalVectors( image, K, sub, p ); },
+      nbThreads, 0, check );
+  return result;
+}
+
+/// Parallel version of IISHG3::getIIMeanCurvatures.
+inline IISHG3::Scalars
+parallelIIMeanCurvatures( DGtal::CountedPtr<IISH3::BinaryImage> bimage,
+                          const IISH3::SurfelRange& surfels,
+                          const DGtal::Parameters& params,
+                          unsigned int nbThreads = 0,
+                          const std::function<void()>& check = nullptr )
+{
+  IISHG3::Scalars result;
+  // CountedPtr is not thread-safe: workers only see the image itself.
+  const IISH3::BinaryImage& image = *bimage;
+  const IISH3::KSpace       K     = IISH3::getKSpace( bimage, params );
+  parallelSurfelEstimation
+    ( surfels, params, result,
+      [&image, &K] ( const IISH3::SurfelRange& sub, const DGtal::Parameters& p )
+      { return IISHG3::getIIMeanCurvatures( image, K, sub, p ); },
+      nbThreads, 0, check );
+  return result;
+}
+
+/// Parallel version of IISHG3::getIIGaussianCurvatures.
+inline IISHG3::Scalars
+parallelIIGaussianCurvatures( DGtal::CountedPtr<IISH3::BinaryImage> bimage,
+                              const IISH3::SurfelRange& surfels,
+                              const DGtal::Parameters& params,
+                              unsigned int nbThreads = 0,
+                          const std::function<void()>& check = nullptr )
+{
+  IISHG3::Scalars result;
+  // CountedPtr is not thread-safe: workers only see the image itself.
+  const IISH3::BinaryImage& image = *bimage;
+  const IISH3::KSpace       K     = IISH3::getKSpace( bimage, params );
+  parallelSurfelEstimation
+    ( surfels, params, result,
+      [&image, &K] ( const IISH3::SurfelRange& sub, const DGtal::Parameters& p )
+      { return IISHG3::getIIGaussianCurvatures( image, K, sub, p ); },
+      nbThreads, 0, check );
+  return result;
+}
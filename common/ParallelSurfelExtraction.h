@@ -0,0 +1,174 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+
+#include "DGtal/base/Common.h"
+
+#include "common/Parallel.h"
+#include "common/SurfelStream.h"
+#include "common/QuadMesh.h"
+
+/// Extracts the boundary surfels of a binary image, and optionally their
+/// quads, by z-slabs on several threads.
+///
+/// Each slab is scanned as by SurfelStream into its own buffer, and the
+/// buffers are concatenated in slab order, so that the result does not
+/// depend on the number of threads (it is the order of SurfelStream).
+///
+/// For the quad mesh, the pointels of the plane z (Khalimsky coordinate
+/// 2z) belong to the slab containing the plane of voxels z. Each slab
+/// numbers the pointels it owns in order of first appearance in its own
+/// quads; the pointels of its upper plane belong to the next slab, which
+/// always has a quad on them, and are looked up there once every slab is
+/// numbered. A pointel thus gets a single index across slabs. Since these
+/// indices depend on the slab boundaries, hence on the number of threads,
+/// vertices are finally renumbered in order of first appearance in the
+/// concatenated quads: the mesh is then the one QuadMesh::init builds
+/// from the same surfels, whatever the slabs.
+///
+/// @tparam TKSpace a 3D Khalimsky space, closed and containing the image domain.
+/// @tparam TImage an image of bool (e.g. Shortcuts::BinaryImage).
+template <typename TKSpace, typename TImage>
+class ParallelSurfelExtraction
+{
+public:
+  typedef TKSpace                          KSpace;
+  typedef TImage                           Image;
+  typedef SurfelStream<KSpace,Image>       Stream;
+  typedef typename Stream::SurfelRange     SurfelRange;
+  typedef typename KSpace::Point           Point;
+
+  /// @param K the Khalimsky space.
+  /// @param image the binary image (not copied).
+  /// @param nbThreads the number of threads (0 means all cores).
+  /// @param slabThickness the number of planes of voxels per slab (0
+  /// gives about 4 slabs per thread).
+  ParallelSurfelExtraction( const KSpace& K, const Image& image,
+                            unsigned int nbThreads = 0, int slabThickness = 0 )
+    : myK( K ), myStream( K, image ),
+      myNbThreads( nbThreads == 0 ? defaultNumberOfThreads() : nbThreads )
+  {
+    const int nbPlanes = myStream.lastPlane() - myStream.firstPlane() + 1;
+    mySlabThickness = slabThickness > 0 ? slabThickness
+      : std::max( 1, nbPlanes / int( 4 * myNbThreads ) );
+    myNbSlabs = std::size_t( ( nbPlanes + mySlabThickness - 1 ) / mySlabThickness );
+  }
+
+  /// @return the number of slabs.
+  std::size_t nbSlabs() const { return myNbSlabs; }
+
+  /// @return the boundary surfels, in the order of SurfelStream.
+  SurfelRange surfels() const
+  {
+    std::vector<SurfelRange> chunks( myNbSlabs );
+    parallelFor( myNbSlabs, [&] ( std::size_t s )
+      {
+        myStream.extract( slabBegin( s ), slabEnd( s ), chunks[ s ] );
+      }, myNbThreads );
+    return concatenate( chunks );
+  }
+
+  /// Builds in \a surfels the boundary surfels and in \a mesh their quads
+  /// (face i is surfel i), embedded at gridstep \a h.
+  template <typename TRealPoint>
+  void quadMesh( SurfelRange& surfels, QuadMesh<TRealPoint>& mesh, double h = 1.0 ) const
+  {
+    typedef QuadMesh<TRealPoint>                    Mesh;
+    typedef std::unordered_map<std::uint64_t,std::size_t> Indices;
+    std::vector<SurfelRange>  chunks( myNbSlabs );
+    std::vector<Indices>      owned( myNbSlabs );  // owned pointel -> local index
+    std::vector< std::vector<Point> > pointels( myNbSlabs ); // owned pointels, by local index
+    std::vector< std::vector< std::array<Point,4> > > corners( myNbSlabs );
+    // Surfels, corners and owned pointels of each slab.
+    parallelFor( myNbSlabs, [&] ( std::size_t s )
+      {
+        myStream.extract( slabBegin( s ), slabEnd( s ), chunks[ s ] );
+        corners[ s ].reserve( chunks[ s ].size() );
+        owned[ s ].reserve( chunks[ s ].size() + 2 );
+        const int kzEnd = 2 * slabEnd( s );
+        for ( const auto& surfel : chunks[ s ] )
+          {
+            corners[ s ].push_back( Mesh::corners( myK, surfel ) );
+            for ( const auto& p : corners[ s ].back() )
+              if ( p[ 2 ] < kzEnd
+                   && owned[ s ].insert( std::make_pair( Mesh::key( p ), pointels[ s ].size() ) ).second )
+                pointels[ s ].push_back( p );
+          }
+      }, myNbThreads );
+    // Global indices of the first pointel of each slab.
+    std::vector<std::size_t> offset( myNbSlabs + 1, 0 );
+    for ( std::size_t s = 0; s < myNbSlabs; ++s )
+      offset[ s + 1 ] = offset[ s ] + pointels[ s ].size();
+    std::vector<std::size_t> first( myNbSlabs + 1, 0 );
+    for ( std::size_t s = 0; s < myNbSlabs; ++s )
+      first[ s + 1 ] = first[ s ] + chunks[ s ].size();
+    mesh.positions.resize( offset.back() );
+    mesh.quads.resize( first.back() );
+    // Quads with global indices, and positions of the owned pointels.
+    parallelFor( myNbSlabs, [&] ( std::size_t s )
+      {
+        const int kzEnd = 2 * slabEnd( s );
+        for ( std::size_t i = 0; i < pointels[ s ].size(); ++i )
+          mesh.positions[ offset[ s ] + i ] = Mesh::embed( pointels[ s ][ i ], h );
+        for ( std::size_t f = 0; f < corners[ s ].size(); ++f )
+          for ( int v = 0; v < 4; ++v )
+            {
+              const Point&      p = corners[ s ][ f ][ v ];
+              const std::size_t o = p[ 2 ] < kzEnd ? s : s + 1;
+              mesh.quads[ first[ s ] + f ][ v ] = offset[ o ] + owned[ o ].at( Mesh::key( p ) );
+            }
+      }, myNbThreads );
+    // Vertices in order of first appearance, independent of the slabs.
+    const std::size_t none = std::size_t( -1 );
+    std::vector<std::size_t> renumber( mesh.positions.size(), none );
+    std::vector<TRealPoint>  positions( mesh.positions.size() );
+    std::size_t n = 0;
+    for ( auto& q : mesh.quads )
+      for ( auto& v : q )
+        {
+          if ( renumber[ v ] == none )
+            {
+              renumber[ v ]    = n;
+              positions[ n++ ] = mesh.positions[ v ];
+            }
+          v = renumber[ v ];
+        }
+    mesh.positions.swap( positions );
+    surfels = concatenate( chunks );
+  }
+
+protected:
+  const KSpace& myK;
+  Stream        myStream;
+  unsigned int  myNbThreads;
+  int           mySlabThickness;
+  std::size_t   myNbSlabs;
+
+  int slabBegin( std::size_t s ) const
+  {
+    return myStream.firstPlane() + int( s ) * mySlabThickness;
+  }
+  int slabEnd( std::size_t s ) const
+  {
+    return std::min( slabBegin( s ) + mySlabThickness, myStream.lastPlane() + 1 );
+  }
+
+  static SurfelRange concatenate( std::vector<SurfelRange>& chunks )
+  {
+    std::size_t n = 0;
+    for ( const auto& c : chunks ) n += c.size();
+    SurfelRange result;
+    result.reserve( n );
+    for ( auto& c : chunks )
+      {
+        result.insert( result.end(), c.begin(), c.end() );
+        SurfelRange().swap( c );
+      }
+    return result;
+  }
+};
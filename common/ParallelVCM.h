@@ -0,0 +1,345 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+#include "DGtal/base/Common.h"
+#include "DGtal/helpers/StdDefs.h"
+#include "DGtal/helpers/Shortcuts.h"
+#include "DGtal/helpers/ShortcutsGeometry.h"
+#include "DGtal/math/linalg/SimpleMatrix.h"
+#include "DGtal/math/linalg/EigenDecomposition.h"
+
+#include "common/Parallel.h"
+#include "common/QuadMesh.h"
+
+/// Voronoi covariance measure (VCM) of a set of digital points, computed
+/// in parallel.
+///
+/// The Voronoi cells of the sites are given by an exact Euclidean
+/// distance transform over their bounding box (enlarged by R), computed
+/// by lower envelopes of parabolas along x, then y, then z, each line
+/// on its own thread. The covariance of each site is the sum of
+/// (x - site)(x - site)^T over the lattice points x of its cell within
+/// distance R, found by scanning the ball of radius R around each site,
+/// again one site per thread. The measure at a point is the sum of the covariances of
+/// the sites within distance r, weighted by a kernel; sites are bucketed
+/// in a uniform grid of cells of size r, stored contiguously, so that
+/// only 27 cells are visited per query.
+class ParallelVCM
+{
+public:
+  typedef DGtal::Z3i::Point                 Point;
+  typedef DGtal::Z3i::RealPoint             RealPoint;
+  typedef DGtal::Z3i::RealVector            RealVector;
+  typedef DGtal::SimpleMatrix<double,3,3>   Matrix;
+
+  /// Computes the covariances of the cells of \a sites (without
+  /// duplicates), for an offset of radius \a R, and indexes the sites
+  /// for kernels of radius \a r.
+  ParallelVCM( const std::vector<Point>& sites, double R, double r,
+               unsigned int nbThreads = 0 )
+    : mySites( sites ), myR( R ), myr( r )
+  {
+    if ( mySites.empty() ) return;
+    computeCovariances( nbThreads );
+    indexSites();
+  }
+
+  /// @return the sites.
+  const std::vector<Point>& sites() const { return mySites; }
+
+  /// @return the number of lattice points in the bounding box.
+  std::size_t nbLatticePoints() const { return myNbLatticePoints; }
+
+  /// @return the VCM at \a c, i.e. the sum of the covariances of the
+  /// sites within distance r of \a c weighted by 1 - d/r (if \a hat) or
+  /// by 1.
+  Matrix measure( const RealPoint& c, bool hat = true ) const
+  {
+    Matrix M;
+    if ( mySites.empty() ) return M;
+    std::array<double,6> S = {{ 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 }};
+    const double r2 = myr * myr;
+    int lo[ 3 ], hi[ 3 ];
+    for ( int k = 0; k < 3; ++k )
+      {
+        lo[ k ] = std::max( 0, cell( c[ k ] - myr, k ) );
+        hi[ k ] = std::min( myCells[ k ] - 1, cell( c[ k ] + myr, k ) );
+      }
+    for ( int z = lo[ 2 ]; z <= hi[ 2 ]; ++z )
+      for ( int y = lo[ 1 ]; y <= hi[ 1 ]; ++y )
+        for ( int x = lo[ 0 ]; x <= hi[ 0 ]; ++x )
+          {
+            const std::size_t b = cellIndex( x, y, z );
+            for ( std::size_t i = myCellStart[ b ]; i < myCellStart[ b + 1 ]; ++i )
+              {
+                const std::size_t s = myCellSites[ i ];
+                const RealPoint   d = RealPoint( mySites[ s ] ) - c;
+                const double     d2 = d.dot( d );
+                if ( d2 > r2 ) continue;
+                const double w = hat ? 1.0 - std::sqrt( d2 ) / myr : 1.0;
+                for ( int k = 0; k < 6; ++k ) S[ k ] += w * myCovariances[ 6 * s + k ];
+              }
+          }
+    M.setComponent( 0, 0, S[ 0 ] );
+    M.setComponent( 1, 1, S[ 1 ] );
+    M.setComponent( 2, 2, S[ 2 ] );
+    M.setComponent( 0, 1, S[ 3 ] ); M.setComponent( 1, 0, S[ 3 ] );
+    M.setComponent( 0, 2, S[ 4 ] ); M.setComponent( 2, 0, S[ 4 ] );
+    M.setComponent( 1, 2, S[ 5 ] ); M.setComponent( 2, 1, S[ 5 ] );
+    return M;
+  }
+
+  /// @return the (unoriented) unit normal given by the measure \a M (the
+  /// eigenvector of its largest eigenvalue).
+  static RealVector normal( const Matrix& M )
+  {
+    Matrix     eigenVectors;
+    RealVector eigenValues;
+    DGtal::EigenDecomposition<3,double>::getEigenDecomposition
+      ( M, eigenVectors, eigenValues );
+    return eigenVectors.column( 2 );
+  }
+
+protected:
+  std::vector<Point>       mySites;
+  double                   myR;
+  double                   myr;
+  std::size_t              myNbLatticePoints = 0;
+  std::vector<double>      myCovariances; ///< xx, yy, zz, xy, xz, yz per site
+  Point                    myLower;       ///< lower corner of the grid of sites
+  int                      myCellSize = 1;
+  int                      myCells[ 3 ];
+  std::vector<std::size_t> myCellStart;   ///< sites of cell b are myCellSites[myCellStart[b]..myCellStart[b+1])
+  std::vector<std::size_t> myCellSites;
+
+  /// Computes the Voronoi cells of the sites within distance R and the
+  /// covariance of each cell.
+  void computeCovariances( unsigned int nbThreads )
+  {
+    const int m = int( std::ceil( myR ) ) + 1;
+    Point lo = mySites[ 0 ], hi = mySites[ 0 ];
+    for ( const auto& p : mySites )
+      for ( int k = 0; k < 3; ++k )
+        {
+          lo[ k ] = std::min( lo[ k ], p[ k ] );
+          hi[ k ] = std::max( hi[ k ], p[ k ] );
+        }
+    lo -= Point::diagonal( m );
+    hi += Point::diagonal( m );
+    const std::size_t n[ 3 ] = { std::size_t( hi[ 0 ] - lo[ 0 ] + 1 ),
+                                 std::size_t( hi[ 1 ] - lo[ 1 ] + 1 ),
+                                 std::size_t( hi[ 2 ] - lo[ 2 ] + 1 ) };
+    myNbLatticePoints = n[ 0 ] * n[ 1 ] * n[ 2 ];
+
+    // Nearest site of each lattice point (-1: none yet).
+    std::vector<std::int32_t> nearest( myNbLatticePoints, -1 );
+    for ( std::size_t s = 0; s < mySites.size(); ++s )
+      {
+        const Point p = mySites[ s ] - lo;
+        nearest[ p[ 0 ] + n[ 0 ] * ( p[ 1 ] + n[ 1 ] * p[ 2 ] ) ] = std::int32_t( s );
+      }
+    const std::size_t stride[ 3 ] = { 1, n[ 0 ], n[ 0 ] * n[ 1 ] };
+    for ( int k = 0; k < 3; ++k )
+      {
+        const std::size_t nbLines = myNbLatticePoints / n[ k ];
+        parallelForChunks( nbLines, 64, [&] ( std::size_t b, std::size_t e, unsigned int )
+          {
+            LowerEnvelope envelope( n[ k ] );
+            for ( std::size_t l = b; l < e; ++l )
+              {
+                // First lattice point of the line, and its coordinates.
+                const std::size_t first = ( l / stride[ k ] ) * stride[ k ] * n[ k ]
+                                        + l % stride[ k ];
+                const Point x( int( first % n[ 0 ] ),
+                               int( ( first / n[ 0 ] ) % n[ 1 ] ),
+                               int( first / ( n[ 0 ] * n[ 1 ] ) ) );
+                envelope.compute( nearest.data() + first, stride[ k ], [&] ( std::int32_t s )
+                  {
+                    const Point d = mySites[ s ] - lo - x;
+                    std::int64_t f = 0;
+                    for ( int j = 0; j < 3; ++j )
+                      if ( j != k ) f += std::int64_t( d[ j ] ) * d[ j ];
+                    return f;
+                  } );
+              }
+          }, nbThreads );
+      }
+
+    // The points of the cell of a site within distance R are the points
+    // of the ball of radius R around it whose nearest site it is: each
+    // site scans its own ball, so that sites are independent.
+    const double R2 = myR * myR;
+    std::vector<Point>          ball;
+    std::vector<std::ptrdiff_t> ballOffsets;
+    for ( int z = -m; z <= m; ++z )
+      for ( int y = -m; y <= m; ++y )
+        for ( int x = -m; x <= m; ++x )
+          if ( double( x * x + y * y + z * z ) <= R2 )
+            {
+              ball.push_back( Point( x, y, z ) );
+              ballOffsets.push_back( std::ptrdiff_t( x ) + std::ptrdiff_t( stride[ 1 ] ) * y
+                                     + std::ptrdiff_t( stride[ 2 ] ) * z );
+            }
+    myCovariances.assign( 6 * mySites.size(), 0.0 );
+    parallelFor( mySites.size(), [&] ( std::size_t s )
+      {
+        double* C = myCovariances.data() + 6 * s;
+        const Point       p    = mySites[ s ] - lo;
+        const std::size_t base = p[ 0 ] + stride[ 1 ] * p[ 1 ] + stride[ 2 ] * p[ 2 ];
+        for ( std::size_t j = 0; j < ball.size(); ++j )
+          {
+            if ( nearest[ base + ballOffsets[ j ] ] != std::int32_t( s ) ) continue;
+            const Point& d = ball[ j ];
+            C[ 0 ] += d[ 0 ] * d[ 0 ];
+            C[ 1 ] += d[ 1 ] * d[ 1 ];
+            C[ 2 ] += d[ 2 ] * d[ 2 ];
+            C[ 3 ] += d[ 0 ] * d[ 1 ];
+            C[ 4 ] += d[ 0 ] * d[ 2 ];
+            C[ 5 ] += d[ 1 ] * d[ 2 ];
+          }
+      }, nbThreads, 256 );
+  }
+
+  /// Buckets the sites in cells of size r.
+  void indexSites()
+  {
+    myCellSize = std::max( 1, int( std::ceil( myr ) ) );
+    myLower    = mySites[ 0 ];
+    Point hi   = mySites[ 0 ];
+    for ( const auto& p : mySites )
+      for ( int k = 0; k < 3; ++k )
+        {
+          myLower[ k ] = std::min( myLower[ k ], p[ k ] );
+          hi[ k ]      = std::max( hi[ k ], p[ k ] );
+        }
+    for ( int k = 0; k < 3; ++k )
+      myCells[ k ] = ( hi[ k ] - myLower[ k ] ) / myCellSize + 1;
+    myCellStart.assign( std::size_t( myCells[ 0 ] ) * myCells[ 1 ] * myCells[ 2 ] + 1, 0 );
+    std::vector<std::size_t> b( mySites.size() );
+    for ( std::size_t s = 0; s < mySites.size(); ++s )
+      {
+        const Point c = mySites[ s ] - myLower;
+        b[ s ] = cellIndex( c[ 0 ] / myCellSize, c[ 1 ] / myCellSize, c[ 2 ] / myCellSize );
+        ++myCellStart[ b[ s ] + 1 ];
+      }
+    for ( std::size_t i = 1; i < myCellStart.size(); ++i )
+      myCellStart[ i ] += myCellStart[ i - 1 ];
+    myCellSites.resize( mySites.size() );
+    std::vector<std::size_t> next( myCellStart.begin(), myCellStart.end() - 1 );
+    for ( std::size_t s = 0; s < mySites.size(); ++s )
+      myCellSites[ next[ b[ s ] ]++ ] = s;
+  }
+
+  int cell( double x, int k ) const
+  {
+    return int( std::floor( ( x - myLower[ k ] ) / myCellSize ) );
+  }
+
+  std::size_t cellIndex( int x, int y, int z ) const
+  {
+    return std::size_t( x ) + myCells[ 0 ] * ( std::size_t( y ) + myCells[ 1 ] * std::size_t( z ) );
+  }
+
+  /// Lower envelope of the parabolas f(i) + (j - i)^2 along a line
+  /// (Felzenszwalb and Huttenlocher), where f(i) is the squared distance
+  /// to the nearest site of point i in the other directions.
+  struct LowerEnvelope
+  {
+    std::vector<std::size_t>  v;   ///< abscissae of the parabolas of the envelope
+    std::vector<double>       z;   ///< boundaries between them
+    std::vector<std::int64_t> f;
+    std::vector<std::int32_t> s;
+
+    explicit LowerEnvelope( std::size_t n ) : v( n ), z( n + 1 ), f( n ), s( n ) {}
+
+    /// Replaces each nearest[ i * stride ] by the nearest site along the line.
+    template <typename Distance>
+    void compute( std::int32_t* nearest, std::size_t stride, const Distance& dist )
+    {
+      const std::size_t n = f.size();
+      long k = -1;
+      for ( std::size_t q = 0; q < n; ++q )
+        {
+          s[ q ] = nearest[ q * stride ];
+          if ( s[ q ] < 0 ) continue;
+          f[ q ] = dist( s[ q ] );
+          double sep = 0.0;
+          while ( k >= 0 )
+            {
+              const std::size_t p = v[ k ];
+              sep = ( double( f[ q ] + std::int64_t( q * q ) )
+                      - double( f[ p ] + std::int64_t( p * p ) ) )
+                / ( 2.0 * ( double( q ) - double( p ) ) );
+              if ( sep > z[ k ] ) break;
+              --k;
+            }
+          ++k;
+          v[ k ]     = q;
+          z[ k ]     = k == 0 ? -std::numeric_limits<double>::infinity() : sep;
+          z[ k + 1 ] = std::numeric_limits<double>::infinity();
+        }
+      if ( k < 0 ) return;
+      long j = 0;
+      for ( std::size_t q = 0; q < n; ++q )
+        {
+          while ( z[ j + 1 ] < double( q ) ) ++j;
+          nearest[ q * stride ] = s[ v[ j ] ];
+        }
+    }
+  };
+};
+
+typedef DGtal::Shortcuts<DGtal::Z3i::KSpace>         VCMSH3;
+typedef DGtal::ShortcutsGeometry<DGtal::Z3i::KSpace> VCMSHG3;
+
+/// Same as VCMSHG3::getVCMNormalVectors (parameters "R-radius",
+/// "r-radius", "kernel", "alpha" and "gridstep"), computed in parallel
+/// on \a nbThreads threads. The sites are the pointels of \a surfels and
+/// the kernel is centered on each surfel. Normals are oriented as the
+/// trivial normals.
+inline VCMSHG3::RealVectors
+getParallelVCMNormalVectors( const VCMSH3::KSpace& K,
+                             const VCMSH3::SurfelRange& surfels,
+                             const DGtal::Parameters& params,
+                             unsigned int nbThreads = 0 )
+{
+  typedef ParallelVCM::Point     Point;
+  typedef ParallelVCM::RealPoint RealPoint;
+  const double h     = params[ "gridstep" ].as<double>();
+  const double alpha = params[ "alpha" ].as<double>();
+  const bool   hat   = params[ "kernel" ].as<std::string>() == "hat";
+  double R = params[ "R-radius" ].as<double>();
+  double r = params[ "r-radius" ].as<double>();
+  if ( alpha != 1.0 )
+    {
+      R *= std::pow( h, alpha - 1.0 );
+      r *= std::pow( h, alpha - 1.0 );
+    }
+  // Pointels, with pointel coordinates (Khalimsky coordinates / 2).
+  std::vector<Point> sites;
+  sites.reserve( 4 * surfels.size() );
+  for ( const auto& s : surfels )
+    for ( const auto& p : QuadMesh<RealPoint>::corners( K, s ) )
+      sites.push_back( Point( p[ 0 ] / 2, p[ 1 ] / 2, p[ 2 ] / 2 ) );
+  std::sort( sites.begin(), sites.end() );
+  sites.erase( std::unique( sites.begin(), sites.end() ), sites.end() );
+
+  const ParallelVCM vcm( sites, R, r, nbThreads );
+  const auto trivial = VCMSHG3::getTrivialNormalVectors( K, surfels );
+  VCMSHG3::RealVectors normals( surfels.size() );
+  parallelFor( surfels.size(), [&] ( std::size_t i )
+    {
+      const RealPoint c = RealPoint( K.sKCoords( surfels[ i ] ) ) * 0.5;
+      const auto      n = ParallelVCM::normal( vcm.measure( c, hat ) );
+      normals[ i ]      = n.dot( trivial[ i ] ) < 0.0 ? -n : n;
+    }, nbThreads, 64 );
+  return normals;
+}
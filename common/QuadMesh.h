@@ -0,0 +1,223 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <utility>
+#include <unordered_map>
+#include <cstddef>
+#include <cstdint>
+
+#include "DGtal/base/Common.h"
+#include "DGtal/shapes/SurfaceMesh.h"
+
+/// Flat quad mesh of a digital surface: one 4-index quad per surfel and
+/// one position per pointel, stored contiguously so that it can be handed
+/// to SurfaceMesh and to polyscope without one allocation per face.
+///
+/// Quads follow the order of the surfel range they are built from, so
+/// that per-surfel quantities computed by ShortcutsGeometry are per-face
+/// quantities of the mesh. Quads are counterclockwise when seen from the
+/// outside (the trivial normal of the surfel), and pointels are embedded
+/// as in the canonic cell embedder (spels at integer points) scaled by the
+/// gridstep.
+///
+/// The edges of the quads and their incidences (the adjacency that
+/// SurfaceMesh would rebuild from the quads) can be built in the same
+/// pass: the edges are the linels of the surfels, found by their
+/// Khalimsky coordinates as the vertices are.
+///
+/// @tparam TRealPoint the type of positions (e.g. Z3i::RealPoint).
+template <typename TRealPoint>
+struct QuadMesh
+{
+  typedef TRealPoint                  RealPoint;
+  typedef std::size_t                 Index;
+  typedef std::array<Index,4>         Quad;
+  typedef DGtal::SurfaceMesh<RealPoint,RealPoint> SurfaceMesh;
+
+  std::vector<Quad>      quads;     ///< vertex indices of each face (n x 4)
+  std::vector<RealPoint> positions; ///< position of each vertex (m x 3)
+
+  /// Edges of the quads and their incidences, in flat arrays (the
+  /// entries of element i of a CSR relation are data[start[i]..start[i+1])).
+  struct Adjacency
+  {
+    std::vector< std::pair<Index,Index> > edges; ///< vertices of each edge, smaller index first
+    std::vector<Quad>  quadEdges;     ///< edge i of a quad joins its vertices i and i+1
+    std::vector<Index> edgeFaceStart; ///< CSR: faces of each edge
+    std::vector<Index> edgeFaces;
+    std::vector<Index> neighborStart; ///< CSR: neighbors of each vertex
+    std::vector<Index> neighbors;
+
+    /// @return the number of edges.
+    Index nbEdges() const { return edges.size(); }
+    /// @return the number of faces of edge \a e (2 inside a closed surface).
+    Index nbFaces( Index e ) const { return edgeFaceStart[ e + 1 ] - edgeFaceStart[ e ]; }
+    /// @return the number of neighbors of vertex \a v.
+    Index nbNeighbors( Index v ) const { return neighborStart[ v + 1 ] - neighborStart[ v ]; }
+  };
+
+  /// Builds the quads of the surfels of \a surfels.
+  /// @param K the Khalimsky space of the surfels.
+  /// @param surfels a range of signed surfels (e.g. Shortcuts::SurfelRange).
+  /// @param h the gridstep.
+  /// @param adjacency if not null, also builds there the edges of the
+  /// quads and their incidences (edges are numbered in order of first
+  /// appearance).
+  template <typename TKSpace, typename TSurfelRange>
+  void init( const TKSpace& K, const TSurfelRange& surfels, double h = 1.0,
+             Adjacency* adjacency = nullptr )
+  {
+    typedef typename TKSpace::Point Point;
+    quads.clear();
+    positions.clear();
+    quads.reserve( surfels.size() );
+    positions.reserve( surfels.size() + 2 );
+    std::unordered_map<std::uint64_t,Index> indices;
+    indices.reserve( 2 * surfels.size() );
+    // A closed quad mesh has 2 edges per face.
+    std::unordered_map<std::uint64_t,Index> edgeIndices;
+    if ( adjacency != nullptr )
+      {
+        *adjacency = Adjacency();
+        adjacency->quadEdges.reserve( surfels.size() );
+        adjacency->edges.reserve( 2 * surfels.size() + 2 );
+        edgeIndices.reserve( 2 * surfels.size() + 2 );
+      }
+    for ( const auto& s : surfels )
+      {
+        const std::array<Point,4> P = corners( K, s );
+        Quad q;
+        for ( int v = 0; v < 4; ++v )
+          q[ v ] = vertex( indices, P[ v ], h );
+        quads.push_back( q );
+        if ( adjacency == nullptr ) continue;
+        Quad e;
+        for ( int i = 0; i < 4; ++i )
+          {
+            // The linel between the pointels i and i+1.
+            Point l = P[ i ];
+            for ( int k = 0; k < 3; ++k ) l[ k ] = ( l[ k ] + P[ ( i + 1 ) % 4 ][ k ] ) / 2;
+            auto it = edgeIndices.find( key( l ) );
+            if ( it == edgeIndices.end() )
+              {
+                it = edgeIndices.insert( std::make_pair( key( l ), adjacency->edges.size() ) ).first;
+                const Index u = q[ i ], v = q[ ( i + 1 ) % 4 ];
+                adjacency->edges.push_back( u < v ? std::make_pair( u, v ) : std::make_pair( v, u ) );
+              }
+            e[ i ] = it->second;
+          }
+        adjacency->quadEdges.push_back( e );
+      }
+    if ( adjacency != nullptr ) incidences( *adjacency );
+  }
+
+  /// @return the Khalimsky coordinates of the pointels of surfel \a s,
+  /// counterclockwise around its trivial (outward) normal.
+  template <typename TKSpace>
+  static std::array<typename TKSpace::Point,4>
+  corners( const TKSpace& K, const typename TKSpace::SCell& s )
+  {
+    typedef typename TKSpace::Point Point;
+    const Point c = K.sKCoords( s );
+    const auto  k = K.sOrthDir( s );
+    const auto  i = ( k + 1 ) % 3;
+    const auto  j = ( k + 2 ) % 3;
+    // (i,j,k) is direct: (-,-),(+,-),(+,+),(-,+) turns around +k, and
+    // the outward normal is -k when the surfel is direct along k.
+    static const int di[ 4 ] = { -1, 1, 1, -1 };
+    static const int dj[ 4 ] = { -1, -1, 1, 1 };
+    const bool reversed = K.sDirect( s, k );
+    std::array<Point,4> P;
+    for ( int v = 0; v < 4; ++v )
+      {
+        Point p = c;
+        p[ i ] += di[ v ];
+        p[ j ] += dj[ v ];
+        P[ reversed ? 3 - v : v ] = p;
+      }
+    return P;
+  }
+
+  /// @return the position of the pointel of Khalimsky coordinates \a p
+  /// at gridstep \a h.
+  template <typename Point>
+  static RealPoint embed( const Point& p, double h )
+  {
+    return RealPoint( h * ( p[ 0 ] - 1 ) * 0.5,
+                      h * ( p[ 1 ] - 1 ) * 0.5,
+                      h * ( p[ 2 ] - 1 ) * 0.5 );
+  }
+
+  /// @return a key identifying the pointel of Khalimsky coordinates \a p.
+  template <typename Point>
+  static std::uint64_t key( const Point& p )
+  {
+    // Khalimsky coordinates fit in 21 bits each for any practical image.
+    return ( std::uint64_t( p[ 0 ] & 0x1fffff ) << 42 )
+      |    ( std::uint64_t( p[ 1 ] & 0x1fffff ) << 21 )
+      |      std::uint64_t( p[ 2 ] & 0x1fffff );
+  }
+
+  /// @return the number of faces.
+  Index nbFaces() const { return quads.size(); }
+  /// @return the number of vertices.
+  Index nbVertices() const { return positions.size(); }
+
+  /// @return a DGtal SurfaceMesh with the same faces and vertices (only
+  /// needed for its services, e.g. geodesics or curvature measures; it
+  /// rebuilds the whole connectivity, that init can give directly).
+  SurfaceMesh makeSurfaceMesh() const
+  {
+    return SurfaceMesh( positions.cbegin(), positions.cend(),
+                        quads.cbegin(), quads.cend() );
+  }
+
+protected:
+  /// Fills the faces of each edge and the neighbors of each vertex of
+  /// \a A from its edges and the edges of each quad.
+  void incidences( Adjacency& A ) const
+  {
+    // Faces of each edge.
+    A.edgeFaceStart.assign( A.edges.size() + 1, 0 );
+    for ( const auto& q : A.quadEdges )
+      for ( int i = 0; i < 4; ++i ) ++A.edgeFaceStart[ q[ i ] + 1 ];
+    for ( std::size_t e = 0; e < A.edges.size(); ++e )
+      A.edgeFaceStart[ e + 1 ] += A.edgeFaceStart[ e ];
+    A.edgeFaces.resize( A.edgeFaceStart.back() );
+    std::vector<Index> next( A.edgeFaceStart.begin(), A.edgeFaceStart.end() - 1 );
+    for ( std::size_t f = 0; f < A.quadEdges.size(); ++f )
+      for ( int i = 0; i < 4; ++i ) A.edgeFaces[ next[ A.quadEdges[ f ][ i ] ]++ ] = f;
+    // Neighbors of each vertex.
+    A.neighborStart.assign( positions.size() + 1, 0 );
+    for ( const auto& e : A.edges )
+      {
+        ++A.neighborStart[ e.first + 1 ];
+        ++A.neighborStart[ e.second + 1 ];
+      }
+    for ( std::size_t v = 0; v < positions.size(); ++v )
+      A.neighborStart[ v + 1 ] += A.neighborStart[ v ];
+    A.neighbors.resize( A.neighborStart.back() );
+    next.assign( A.neighborStart.begin(), A.neighborStart.end() - 1 );
+    for ( const auto& e : A.edges )
+      {
+        A.neighbors[ next[ e.first ]++ ]  = e.second;
+        A.neighbors[ next[ e.second ]++ ] = e.first;
+      }
+  }
+
+  /// @return the index of the pointel of Khalimsky coordinates \a p,
+  /// creating it if needed.
+  template <typename Point>
+  Index vertex( std::unordered_map<std::uint64_t,Index>& indices,
+                const Point& p, double h )
+  {
+    const std::uint64_t k = key( p );
+    auto it = indices.find( k );
+    if ( it != indices.end() ) return it->second;
+    const Index idx = positions.size();
+    indices[ k ] = idx;
+    positions.push_back( embed( p, h ) );
+    return idx;
+  }
+};
@@ -0,0 +1,320 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+
+#include "DGtal/base/Common.h"
+#include "DGtal/helpers/StdDefs.h"
+#include "DGtal/helpers/Shortcuts.h"
+#include "DGtal/helpers/ShortcutsGeometry.h"
+#include "DGtal/math/linalg/SimpleMatrix.h"
+#include "DGtal/math/linalg/EigenDecomposition.h"
+
+#include "common/Parallel.h"
+
+/// Integral invariant (II) estimation whose cost per surfel grows as r^2
+/// instead of r^3. The moments of a ball are computed once and give the
+/// normal, the mean, Gaussian and principal curvatures together (see
+/// geometry()).
+///
+/// The binary image is stored as runs of foreground voxels along x, one
+/// list per (y,z) row. The ball of radius R around a surfel meets each
+/// row in an interval, and the moments of order 0, 1 and 2 of the voxels
+/// of a run in this interval have closed forms. Summing over the O(R^2)
+/// rows of the ball gives the volume and the covariance matrix of the
+/// intersection of the ball with the shape, from which the normal (the
+/// eigenvector of the smallest eigenvalue) and the mean curvature
+/// (from the volume) follow.
+///
+/// The ball contains the voxels whose centers are at distance at most R
+/// from the surfel center, so values may slightly differ from the
+/// DGtal convolver, which uses its own digital kernel.
+///
+/// The cost per surfel is thus not independent of the radius: it is
+/// O(R^2) row queries (each a search among the runs of the row) instead
+/// of O(R^3) voxels. A radius-independent cost would need the moments
+/// convolved with the ball over the whole image (e.g. by FFT), i.e. ten
+/// full-size volumes of doubles, which does not fit the large images
+/// this estimator is meant for.
+class RunLengthIntegralInvariant
+{
+public:
+  typedef DGtal::Z3i::Point                 Point;
+  typedef DGtal::Z3i::RealPoint             RealPoint;
+  typedef DGtal::Z3i::RealVector            RealVector;
+  typedef DGtal::SimpleMatrix<double,3,3>   Matrix;
+
+  /// Moments of order up to 2 of a set of voxels, relative to a center.
+  struct Moments
+  {
+    double m000 = 0.0;
+    double m100 = 0.0, m010 = 0.0, m001 = 0.0;
+    double m200 = 0.0, m020 = 0.0, m002 = 0.0;
+    double m110 = 0.0, m101 = 0.0, m011 = 0.0;
+
+    /// @return the covariance matrix of the set.
+    Matrix covariance() const
+    {
+      Matrix C;
+      if ( m000 == 0.0 ) return C;
+      const double cx = m100 / m000, cy = m010 / m000, cz = m001 / m000;
+      C.setComponent( 0, 0, m200 / m000 - cx * cx );
+      C.setComponent( 1, 1, m020 / m000 - cy * cy );
+      C.setComponent( 2, 2, m002 / m000 - cz * cz );
+      C.setComponent( 0, 1, m110 / m000 - cx * cy );
+      C.setComponent( 0, 2, m101 / m000 - cx * cz );
+      C.setComponent( 1, 2, m011 / m000 - cy * cz );
+      C.setComponent( 1, 0, C( 0, 1 ) );
+      C.setComponent( 2, 0, C( 0, 2 ) );
+      C.setComponent( 2, 1, C( 1, 2 ) );
+      return C;
+    }
+  };
+
+  /// Builds the runs of the voxels of \a image that are 'true'.
+  /// @tparam TImage a 3D image of bool (e.g. Shortcuts::BinaryImage).
+  template <typename TImage>
+  explicit RunLengthIntegralInvariant( const TImage& image )
+    : myLower( image.domain().lowerBound() ),
+      myUpper( image.domain().upperBound() )
+  {
+    const Point size = myUpper - myLower + Point::diagonal( 1 );
+    myRowStart.assign( std::size_t( size[ 1 ] ) * size[ 2 ] + 1, 0 );
+    for ( int z = myLower[ 2 ]; z <= myUpper[ 2 ]; ++z )
+      for ( int y = myLower[ 1 ]; y <= myUpper[ 1 ]; ++y )
+        {
+          int start = 0;
+          bool in   = false;
+          for ( int x = myLower[ 0 ]; x <= myUpper[ 0 ]; ++x )
+            {
+              const bool v = image( Point( x, y, z ) );
+              if ( v && ! in )  { start = x; in = true; }
+              if ( ! v && in )  { myRuns.push_back( Run( start, x - 1 ) ); in = false; }
+            }
+          if ( in ) myRuns.push_back( Run( start, myUpper[ 0 ] ) );
+          myRowStart[ row( y, z ) + 1 ] = myRuns.size();
+        }
+  }
+
+  /// @return the moments of the voxels within distance \a R of \a c,
+  /// relative to \a c (in grid units).
+  Moments moments( const RealPoint& c, double R ) const
+  {
+    Moments M;
+    const double R2 = R * R;
+    const int z0 = std::max( myLower[ 2 ], (int) std::ceil( c[ 2 ] - R ) );
+    const int z1 = std::min( myUpper[ 2 ], (int) std::floor( c[ 2 ] + R ) );
+    for ( int z = z0; z <= z1; ++z )
+      {
+        const double w  = z - c[ 2 ];
+        const double ry = std::sqrt( std::max( 0.0, R2 - w * w ) );
+        const int y0 = std::max( myLower[ 1 ], (int) std::ceil( c[ 1 ] - ry ) );
+        const int y1 = std::min( myUpper[ 1 ], (int) std::floor( c[ 1 ] + ry ) );
+        for ( int y = y0; y <= y1; ++y )
+          {
+            const double v  = y - c[ 1 ];
+            const double rx = std::sqrt( std::max( 0.0, R2 - w * w - v * v ) );
+            const int xmin  = (int) std::ceil( c[ 0 ] - rx );
+            const int xmax  = (int) std::floor( c[ 0 ] + rx );
+            if ( xmin > xmax ) continue;
+            double n = 0.0, su = 0.0, suu = 0.0;
+            rowMoments( row( y, z ), xmin, xmax, c[ 0 ], n, su, suu );
+            if ( n == 0.0 ) continue;
+            M.m000 += n;
+            M.m100 += su;
+            M.m010 += v * n;
+            M.m001 += w * n;
+            M.m200 += suu;
+            M.m020 += v * v * n;
+            M.m002 += w * w * n;
+            M.m110 += v * su;
+            M.m101 += w * su;
+            M.m011 += v * w * n;
+          }
+      }
+    return M;
+  }
+
+  /// @return the (unoriented) unit normal given by the moments \a M.
+  static RealVector normal( const Moments& M )
+  {
+    Matrix     eigenVectors;
+    RealVector eigenValues;
+    DGtal::EigenDecomposition<3,double>::getEigenDecomposition
+      ( M.covariance(), eigenVectors, eigenValues );
+    return eigenVectors.column( 0 );
+  }
+
+  /// @return the mean curvature given by the moments \a M, for a ball
+  /// of radius \a r (real units) at gridstep \a h.
+  static double meanCurvature( const Moments& M, double r, double h )
+  {
+    const double V = M.m000 * h * h * h;
+    return 8.0 / ( 3.0 * r ) - 4.0 * V / ( M_PI * r * r * r * r );
+  }
+
+  /// Quantities estimated from the moments of one ball.
+  struct Geometry
+  {
+    RealVector normal;   ///< unoriented unit normal
+    double     mean;     ///< mean curvature (from the volume)
+    double     gaussian; ///< Gaussian curvature (k1 k2)
+    double     k1, k2;   ///< principal curvatures, k1 >= k2
+    RealVector d1, d2;   ///< principal directions of k1 and k2
+  };
+
+  /// @return the normal and curvatures given by the moments \a M, for a
+  /// ball of radius \a r (real units) at gridstep \a h, with a single
+  /// eigen decomposition of the covariance matrix (as the
+  /// IIPrincipalCurvatures3DFunctor of DGtal).
+  static Geometry geometry( const Moments& M, double r, double h )
+  {
+    Matrix     eigenVectors;
+    RealVector eigenValues;
+    // Central moments of order 2 of the ball, in real units.
+    const double scale = M.m000 * std::pow( h, 5 );
+    DGtal::EigenDecomposition<3,double>::getEigenDecomposition
+      ( M.covariance() * scale, eigenVectors, eigenValues );
+    const double c  = 6.0 / ( M_PI * std::pow( r, 6 ) );
+    const double c0 = 8.0 / ( 5.0 * r );
+    Geometry G;
+    G.normal   = eigenVectors.column( 0 );
+    G.mean     = meanCurvature( M, r, h );
+    G.k1       = c * ( eigenValues[ 2 ] - 3.0 * eigenValues[ 1 ] ) + c0;
+    G.k2       = c * ( eigenValues[ 1 ] - 3.0 * eigenValues[ 2 ] ) + c0;
+    G.gaussian = G.k1 * G.k2;
+    G.d1       = eigenVectors.column( 1 );
+    G.d2       = eigenVectors.column( 2 );
+    return G;
+  }
+
+  /// @return the center of surfel \a s in grid units (voxel centers are
+  /// the digital points).
+  template <typename TKSpace>
+  static RealPoint center( const TKSpace& K, const typename TKSpace::SCell& s )
+  {
+    const Point k = K.sKCoords( s );
+    return ( RealPoint( k ) - RealPoint::diagonal( 1.0 ) ) * 0.5;
+  }
+
+  /// @return the memory used by the runs, in bytes.
+  std::size_t memory() const
+  {
+    return myRuns.size() * sizeof( Run ) + myRowStart.size() * sizeof( std::size_t );
+  }
+
+protected:
+  /// A run [first,second] of foreground voxels along x.
+  typedef std::pair<int,int> Run;
+
+  Point                    myLower;
+  Point                    myUpper;
+  std::vector<Run>         myRuns;
+  std::vector<std::size_t> myRowStart; ///< runs of row r are [myRowStart[r],myRowStart[r+1])
+
+  std::size_t row( int y, int z ) const
+  {
+    const std::size_t sy = myUpper[ 1 ] - myLower[ 1 ] + 1;
+    return std::size_t( z - myLower[ 2 ] ) * sy + std::size_t( y - myLower[ 1 ] );
+  }
+
+  /// Adds the count, sum of (x-cx) and sum of (x-cx)^2 over the
+  /// foreground voxels of row \a r with x in [xmin,xmax].
+  void rowMoments( std::size_t r, int xmin, int xmax, double cx,
+                   double& n, double& su, double& suu ) const
+  {
+    auto itb = myRuns.begin() + myRowStart[ r ];
+    auto ite = myRuns.begin() + myRowStart[ r + 1 ];
+    auto it  = std::lower_bound( itb, ite, xmin,
+                                 [] ( const Run& run, int x ) { return run.second < x; } );
+    for ( ; it != ite && it->first <= xmax; ++it )
+      {
+        const double a = std::max( it->first,  xmin ) - cx;
+        const double b = std::min( it->second, xmax ) - cx;
+        const double k = b - a + 1.0;
+        // sums of u and u^2 for u = a, a+1, ..., b
+        n   += k;
+        su  += k * ( a + b ) * 0.5;
+        suu += ( S2( b ) - S2( a - 1.0 ) );
+      }
+  }
+
+  /// @return x(x+1)(2x+1)/6. Since S2(x) - S2(x-1) = x^2 for any real x,
+  /// S2(b) - S2(a-1) is the sum of u^2 for u = a, a+1, ..., b.
+  static double S2( double x )
+  {
+    return x * ( x + 1.0 ) * ( 2.0 * x + 1.0 ) / 6.0;
+  }
+};
+
+typedef DGtal::Shortcuts<DGtal::Z3i::KSpace>         RLSH3;
+typedef DGtal::ShortcutsGeometry<DGtal::Z3i::KSpace> RLSHG3;
+
+/// Same as RLSHG3::getIINormalVectors (parameters "r-radius" and
+/// "gridstep"), with the run-length backend and \a nbThreads threads.
+/// Normals are oriented as the trivial normals.
+inline RLSHG3::RealVectors
+getRunLengthIINormalVectors( const RunLengthIntegralInvariant& II,
+                             const RLSH3::KSpace& K,
+                             const RLSH3::SurfelRange& surfels,
+                             const DGtal::Parameters& params,
+                             unsigned int nbThreads = 0 )
+{
+  const double h = params[ "gridstep" ].as<double>();
+  const double R = params[ "r-radius" ].as<double>() / h;
+  const auto trivial = RLSHG3::getTrivialNormalVectors( K, surfels );
+  RLSHG3::RealVectors normals( surfels.size() );
+  parallelFor( surfels.size(), [&] ( std::size_t i )
+    {
+      const auto c  = RunLengthIntegralInvariant::center( K, surfels[ i ] );
+      const auto n  = RunLengthIntegralInvariant::normal( II.moments( c, R ) );
+      normals[ i ]  = n.dot( trivial[ i ] ) < 0.0 ? -n : n;
+    }, nbThreads, 64 );
+  return normals;
+}
+
+/// Same as RLSHG3::getIIMeanCurvatures, with the run-length backend.
+inline RLSHG3::Scalars
+getRunLengthIIMeanCurvatures( const RunLengthIntegralInvariant& II,
+                              const RLSH3::KSpace& K,
+                              const RLSH3::SurfelRange& surfels,
+                              const DGtal::Parameters& params,
+                              unsigned int nbThreads = 0 )
+{
+  const double h = params[ "gridstep" ].as<double>();
+  const double r = params[ "r-radius" ].as<double>();
+  RLSHG3::Scalars curvatures( surfels.size() );
+  parallelFor( surfels.size(), [&] ( std::size_t i )
+    {
+      const auto c    = RunLengthIntegralInvariant::center( K, surfels[ i ] );
+      curvatures[ i ] = RunLengthIntegralInvariant::meanCurvature( II.moments( c, r / h ), r, h );
+    }, nbThreads, 64 );
+  return curvatures;
+}
+
+/// Normals (oriented as the trivial normals) and curvatures of \a surfels
+/// given by RunLengthIntegralInvariant::geometry, i.e. one ball of radius
+/// "r-radius" and one eigen decomposition per surfel, on \a nbThreads
+/// threads.
+inline std::vector<RunLengthIntegralInvariant::Geometry>
+getRunLengthIIGeometry( const RunLengthIntegralInvariant& II,
+                        const RLSH3::KSpace& K,
+                        const RLSH3::SurfelRange& surfels,
+                        const DGtal::Parameters& params,
+                        unsigned int nbThreads = 0 )
+{
+  const double h = params[ "gridstep" ].as<double>();
+  const double r = params[ "r-radius" ].as<double>();
+  const auto trivial = RLSHG3::getTrivialNormalVectors( K, surfels );
+  std::vector<RunLengthIntegralInvariant::Geometry> geometry( surfels.size() );
+  parallelFor( surfels.size(), [&] ( std::size_t i )
+    {
+      const auto c = RunLengthIntegralInvariant::center( K, surfels[ i ] );
+      auto       G = RunLengthIntegralInvariant::geometry( II.moments( c, r / h ), r, h );
+      if ( G.normal.dot( trivial[ i ] ) < 0.0 ) G.normal = -G.normal;
+      geometry[ i ] = G;
+    }, nbThreads, 64 );
+  return geometry;
+}
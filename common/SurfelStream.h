@@ -0,0 +1,119 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+
+#include "DGtal/base/Common.h"
+
+/// Streams the boundary surfels of a binary image slab by slab along z,
+/// without building the set of all surfels.
+///
+/// Each call to next() scans \a slabThickness planes of voxels and gives
+/// the surfels between a voxel of these planes and its lower neighbor
+/// along x, y or z, plus the surfels on the upper faces of the domain.
+/// Every boundary surfel is given exactly once, in a deterministic order.
+/// Surfels are oriented as those of Shortcuts digital surfaces: their
+/// direct incident spel is in the shape, and voxels outside the image
+/// domain are outside the shape.
+///
+/// @tparam TKSpace a 3D Khalimsky space, closed and containing the image domain.
+/// @tparam TImage an image of bool (e.g. Shortcuts::BinaryImage).
+template <typename TKSpace, typename TImage>
+class SurfelStream
+{
+public:
+  typedef TKSpace                     KSpace;
+  typedef TImage                      Image;
+  typedef typename KSpace::Point      Point;
+  typedef typename KSpace::SCell      SCell;
+  typedef std::vector<SCell>          SurfelRange;
+  typedef typename Image::Domain      Domain;
+
+  /// @param K the Khalimsky space.
+  /// @param image the binary image (not copied).
+  /// @param slabThickness the number of planes of voxels per chunk.
+  SurfelStream( const KSpace& K, const Image& image, int slabThickness = 16 )
+    : myK( K ), myImage( image ), myDomain( image.domain() ),
+      mySlabThickness( std::max( 1, slabThickness ) )
+  {
+    reset();
+  }
+
+  /// Restarts the stream from the lowest plane.
+  void reset() { myZ = firstPlane(); }
+
+  /// Gives the surfels of the next slab in \a chunk (cleared first).
+  /// @return 'false' when the whole image has been scanned.
+  bool next( SurfelRange& chunk )
+  {
+    chunk.clear();
+    if ( myZ > lastPlane() ) return false;
+    const int zEnd = std::min( myZ + mySlabThickness, lastPlane() + 1 );
+    extract( myZ, zEnd, chunk );
+    myZ = zEnd;
+    return true;
+  }
+
+  /// Appends to \a chunk the surfels of the planes [z0,z1), in the order
+  /// of next(). Does not change the stream, and may be called by several
+  /// threads at once.
+  void extract( int z0, int z1, SurfelRange& chunk ) const
+  {
+    const Point lo = myDomain.lowerBound();
+    const Point hi = myDomain.upperBound();
+    for ( int z = z0; z < z1; ++z )
+      for ( int y = lo[ 1 ]; y <= hi[ 1 ] + 1; ++y )
+        for ( int x = lo[ 0 ]; x <= hi[ 0 ] + 1; ++x )
+          {
+            const Point p( x, y, z );
+            const bool  v = at( p );
+            for ( int k = 0; k < 3; ++k )
+              {
+                Point q = p;
+                --q[ k ];
+                if ( v != at( q ) ) chunk.push_back( surfel( v ? p : q, k, v ) );
+              }
+          }
+  }
+
+  /// @return the first plane of voxels scanned.
+  int firstPlane() const { return myDomain.lowerBound()[ 2 ]; }
+  /// @return the last plane scanned (the plane hi+1 only has faces
+  /// between hi and the outside).
+  int lastPlane() const { return myDomain.upperBound()[ 2 ] + 1; }
+
+  /// Calls `f( chunk )` on each chunk of surfels, from the current position.
+  template <typename Functor>
+  void forEachChunk( Functor f )
+  {
+    SurfelRange chunk;
+    while ( next( chunk ) ) f( chunk );
+  }
+
+  /// @return the first plane of the next slab.
+  int currentPlane() const { return myZ; }
+
+protected:
+  const KSpace& myK;
+  const Image&  myImage;
+  Domain        myDomain;
+  int           mySlabThickness;
+  int           myZ;
+
+  /// @return the value of voxel \a p ('false' outside the domain).
+  bool at( const Point& p ) const
+  {
+    return myDomain.isInside( p ) && myImage( p );
+  }
+
+  /// @return the surfel of inner voxel \a inner orthogonal to \a k, on
+  /// its lower face if \a lowerFace, on its upper face otherwise.
+  SCell surfel( const Point& inner, int k, bool lowerFace ) const
+  {
+    Point c = inner * 2 + Point::diagonal( 1 );
+    c[ k ] += lowerFace ? -1 : 1;
+    SCell s = myK.sCell( c, myK.POS );
+    if ( myK.sCoords( myK.sDirectIncident( s, k ) ) != inner ) s = myK.sOpp( s );
+    return s;
+  }
+};
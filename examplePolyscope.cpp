@@ -7,6 +7,9 @@
 #include <polyscope/polyscope.h>
 #include <polyscope/surface_mesh.h>
 
+#include "common/QuadMesh.h"
+#include "common/AdaptiveDigitalSurface.h"
+
 
 using namespace DGtal;
 using namespace Z3i;
@@ -27,16 +30,15 @@ int main()
   auto digitized_shape = SH3::makeDigitizedImplicitShape3D( implicit_shape, params );
   auto K               = SH3::getKSpace( params );
   auto binary_image    = SH3::makeBinaryImage( digitized_shape, params );
-  auto surface         = SH3::makeLightDigitalSurface( binary_image, K, params );
-  SH3::Cell2Index c2i;
-  auto primalSurface   = SH3::makePrimalPolygonalSurface(c2i, surface);
+  params( "surfaceComponents", "AnyBig" );
+  auto surface         = makeAdaptiveDigitalSurface( binary_image, K, params );
+  auto surfels         = surface.surfels();
   
-  //Need to convert the faces
-  std::vector<std::vector<std::size_t>> faces;
-  for(auto &face: primalSurface->allFaces())
-    faces.push_back(primalSurface->verticesAroundFace( face ));
+  //Flat quad and position buffers, in surfel order
+  QuadMesh<RealPoint> mesh;
+  mesh.init( K, surfels );
     
-  auto digsurf = polyscope::registerSurfaceMesh("Primal surface", primalSurface->positions(), faces);
+  auto digsurf = polyscope::registerSurfaceMesh("Primal surface", mesh.positions, mesh.quads);
   digsurf->setEdgeWidth(1.0);
   digsurf->setEdgeColor({1.,1.,1.});
   
@@ -0,0 +1,166 @@
+#include <iostream>
+#include <chrono>
+#include <limits>
+
+#include "CLI11.hpp"
+
+#include "DGtal/base/Common.h"
+#include "DGtal/helpers/StdDefs.h"
+
+#include "DGtal/shapes/Shapes.h"
+#include "DGtal/shapes/ShapeFactory.h"
+#include "DGtal/shapes/GaussDigitizer.h"
+#include "DGtal/geometry/curves/GridCurve.h"
+
+#include "common/CurveEstimators2D.h"
+
+using namespace DGtal;
+using namespace Z2i;
+
+//------------------------------------------------------------------------------
+template <typename TShape, typename TKSpace>
+void fillShapeBoundary( const TShape& aShape,
+			double aH,
+			TKSpace& aKSpace,
+			std::vector<typename TKSpace::Point>& aVector) {
+
+  GaussDigitizer<typename TKSpace::Space,TShape> dig;
+  dig.attach( aShape );
+  dig.init( aShape.getLowerBound(), aShape.getUpperBound(), aH );
+  if (! aKSpace.init( dig.getLowerBound(), dig.getUpperBound(), true ) )
+    throw std::runtime_error("Error in creating KSpace");
+  SurfelAdjacency<TKSpace::dimension> sAdj( true );
+  typename TKSpace::SCell bel
+    = Surfaces<TKSpace>::findABel( aKSpace, dig, 10000 );
+  Surfaces<TKSpace>::track2DBoundaryPoints( aVector, aKSpace, sAdj, dig, bel );
+}
+
+//------------------------------------------------------------------------------
+/// True unit normals and curvatures at the middle of each step of the curve.
+template <typename TShape>
+void getTrueValues( const TShape& aShape, const Curve& aCurve, double aH,
+                    std::vector<RealVector>& normals,
+                    std::vector<double>& curvatures )
+{
+  auto range = aCurve.getPointsRange();
+  std::vector<Point> points( range.begin(), range.end() );
+  const std::size_t n = points.size();
+  normals.resize( n );
+  curvatures.resize( n );
+  for ( std::size_t i = 0; i < n; ++i ) {
+    // pointels lie at the corners of the pixels
+    const RealPoint m = ( RealPoint( points[ i ] ) + RealPoint( points[ ( i + 1 ) % n ] ) ) * 0.5;
+    const RealPoint x = ( m - RealPoint( 0.5, 0.5 ) ) * aH;
+    const double    t = aShape.parameter( x );
+    RealPoint tangent = aShape.tangent( t );
+    tangent          /= tangent.norm();
+    normals[ i ]      = RealVector( -tangent[ 1 ], tangent[ 0 ] );
+    curvatures[ i ]   = aShape.curvature( t );
+  }
+}
+
+//------------------------------------------------------------------------------
+/// Runs every estimator on one curve and prints a line per estimator.
+struct BenchmarkVisitor
+{
+  std::string                     shapeName;
+  const Curve&                    curve;
+  double                          h;
+  unsigned int                    repeat;
+  const std::vector<RealVector>&  trueNormals;
+  const std::vector<double>&      trueCurvatures;
+
+  template <typename Estimator>
+  void visit()
+  {
+    std::vector<RealVector> normals;
+    std::vector<double>     curvatures;
+    double time = std::numeric_limits<double>::max();
+    for ( unsigned int r = 0; r < repeat; ++r ) {
+      auto start = std::chrono::steady_clock::now();
+      Estimator::estimate( curve, h, normals, curvatures );
+      auto end   = std::chrono::steady_clock::now();
+      time = std::min( time, std::chrono::duration<double, std::milli>( end - start ).count() );
+    }
+
+    // Normal errors (angles, regardless of the orientation)
+    const std::size_t n = trueNormals.size();
+    double nMean = 0.0, nMax = 0.0;
+    for ( std::size_t i = 0; i < n; ++i ) {
+      const double a = acos( std::min( 1.0, std::abs( normals[ i ].dot( trueNormals[ i ] ) ) ) );
+      nMean += a;
+      nMax   = std::max( nMax, a );
+    }
+    nMean /= n;
+
+    // Curvature errors (the sign depends on the orientation of the curve)
+    double kMean = -1.0, kMax = -1.0;
+    if ( ! curvatures.empty() ) {
+      double dot = 0.0;
+      for ( std::size_t i = 0; i < n; ++i ) dot += curvatures[ i ] * trueCurvatures[ i ];
+      const double sign = dot < 0.0 ? -1.0 : 1.0;
+      kMean = kMax = 0.0;
+      for ( std::size_t i = 0; i < n; ++i ) {
+        const double e = std::abs( sign * curvatures[ i ] - trueCurvatures[ i ] );
+        kMean += e;
+        kMax   = std::max( kMax, e );
+      }
+      kMean /= n;
+    }
+    std::cout << shapeName << " " << h << " " << Estimator::name() << " "
+              << n << " " << time << " "
+              << nMean << " " << nMax << " "
+              << kMean << " " << kMax << std::endl;
+  }
+};
+
+//------------------------------------------------------------------------------
+template <typename TShape>
+void benchmark( const std::string& shapeName, const TShape& shape,
+                const std::vector<double>& gridsteps,
+                const std::vector<std::string>& estimators,
+                unsigned int repeat )
+{
+  for ( double h : gridsteps ) {
+    KSpace kspace;
+    std::vector<Point> points;
+    fillShapeBoundary( shape, h, kspace, points );
+    Curve gridcurve( kspace );
+    gridcurve.initFromVector( points );
+
+    std::vector<RealVector> trueNormals;
+    std::vector<double>     trueCurvatures;
+    getTrueValues( shape, gridcurve, h, trueNormals, trueCurvatures );
+
+    BenchmarkVisitor visitor = { shapeName, gridcurve, h, repeat,
+                                 trueNormals, trueCurvatures };
+    for ( const auto& name : estimators )
+      visitCurveEstimator( name, visitor );
+  }
+}
+
+//------------------------------------------------------------------------------
+int main( int argc, char** argv )
+{
+  CLI::App app{"Speed and accuracy of 2D normal/curvature estimators"};
+  std::vector<double>      gridsteps  = { 0.1, 0.05, 0.02, 0.01 };
+  std::vector<std::string> estimators = curveEstimatorNames();
+  unsigned int repeat = 3;
+  app.add_option("-g,--gridsteps", gridsteps, "Grid steps", true);
+  app.add_option("-e,--estimators", estimators, "Estimators", true)
+    ->check(CLI::IsMember(curveEstimatorNames()));
+  app.add_option("-r,--repeat", repeat, "Runs per estimator (the fastest is kept)", true);
+  CLI11_PARSE(app,argc,argv);
+
+  trace.beginBlock ( "Benchmark" );
+  std::cout << "# shape h estimator size time_ms "
+            << "normal_mean normal_max curv_mean curv_max" << std::endl;
+  std::cout << "# (angles in radians, -1 when the estimator gives no curvature)" << std::endl;
+  Ellipse2D<Space> ellipse( 0.5, 0.5, 5.0, 3.0, 0.3 );
+  benchmark( "ellipse", ellipse, gridsteps, estimators, repeat );
+  Flower2D<Space> flower( 0.5, 0.5, 5.0, 3.0, 5, 0.3 );
+  benchmark( "flower", flower, gridsteps, estimators, repeat );
+  trace.endBlock();
+
+  return EXIT_SUCCESS;
+}
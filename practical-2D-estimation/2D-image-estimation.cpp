@@ -0,0 +1,204 @@
+#include <iostream>
+#include <fstream>
+#include <chrono>
+
+#include "CLI11.hpp"
+
+#include "DGtal/base/Common.h"
+#include "DGtal/helpers/StdDefs.h"
+#include "DGtal/images/ImageContainerBySTLVector.h"
+#include "DGtal/io/readers/GenericReader.h"
+
+#include "common/Parallel.h"
+#include "common/CurveEstimators2D.h"
+#include "common/ChainCodeCurve.h"
+#include "common/ContourExtraction2D.h"
+#include "common/GridCurveSVGWriter.h"
+
+using namespace DGtal;
+using namespace Z2i;
+
+typedef ImageContainerBySTLVector<Domain, unsigned char> Image;
+typedef ChainCodeCurve<KSpace>                            Curve;
+
+/// Estimations on one contour.
+struct ContourResult
+{
+  std::size_t             size = 0;          ///< number of steps
+  double                  length = 0.0;      ///< estimated length
+  double                  totalCurvature = 0.0;
+  std::vector<RealVector> normals;
+  std::vector<double>     curvatures;
+};
+
+//------------------------------------------------------------------------------
+/// Reads a PBM image (P1 or P4), black pixels (1) become 255. Rows are
+/// stored bottom to top, as PGMReader does: the first row of the file is
+/// at y = h-1, so that PBM and PGM versions of an image give the same
+/// contours.
+Image importPBM( const std::string& filename )
+{
+  std::ifstream in( filename.c_str(), std::ios::binary );
+  std::string magic;
+  in >> magic;
+  if ( ! in || ( magic != "P1" && magic != "P4" ) )
+    throw std::runtime_error( "Not a PBM file: " + filename );
+  auto skip = [&in] ()
+    {
+      in >> std::ws;
+      while ( in.peek() == '#' ) { in.ignore( 1 << 20, '\n' ); in >> std::ws; }
+    };
+  int w, h;
+  skip(); in >> w;
+  skip(); in >> h;
+  in.get(); // single whitespace before binary data
+  Image image( Domain( Point( 0, 0 ), Point( w - 1, h - 1 ) ) );
+  for ( int r = 0; r < h; ++r )
+    {
+      const int y = h - 1 - r;
+      int byte = 0;
+      for ( int x = 0; x < w; ++x )
+        {
+          int bit;
+          if ( magic == "P1" ) { skip(); bit = in.get() - '0'; }
+          else
+            {
+              if ( x % 8 == 0 ) byte = in.get();
+              bit = ( byte >> ( 7 - x % 8 ) ) & 1;
+            }
+          image.setValue( Point( x, y ), bit ? 255 : 0 );
+        }
+    }
+  if ( ! in ) throw std::runtime_error( "Truncated PBM file: " + filename );
+  return image;
+}
+
+//------------------------------------------------------------------------------
+/// Normal, curvature and length estimation on one contour, as in 2D-estimation.
+void estimate( const std::string& estimatorName, const Curve& curve, double h,
+               ContourResult& result )
+{
+  result.size = curve.size();
+  estimateOnCurve( estimatorName, curve, h, result.normals, result.curvatures );
+
+  auto range = curve.getIncidentPointsRange();
+  unsigned int idx = 0;
+  for ( auto it = range.begin(); it != range.end(); ++it, ++idx ) {
+    Vector trivialNormal = it->first - it->second;
+    const double measure = std::abs( trivialNormal.dot( result.normals[ idx ] ) );
+    result.length += h * measure;
+    if ( ! result.curvatures.empty() )
+      result.totalCurvature += h * measure * result.curvatures[ idx ];
+  }
+}
+
+//------------------------------------------------------------------------------
+int main( int argc, char** argv )
+{
+  CLI::App app{"Normal and curvature estimation on every contour of a 2D image"};
+  std::string filename;
+  std::string svgFilename;
+  std::string outFilename;
+  double h = 1.0;
+  int threshold = 0;
+  unsigned int nbThreads = 0;
+  std::size_t minSize = 8;
+  std::string estimatorName = DCAEstimator::name();
+  app.add_option("-i,--input,1", filename, "Input PGM or PBM file")->required()->check(CLI::ExistingFile);
+  app.add_option("-t,--threshold", threshold, "Foreground is value > threshold", true);
+  app.add_option("--gridstep", h, "Grid step", true);
+  app.add_option("-j,--threads", nbThreads, "Number of threads (0 = all cores)", true);
+  app.add_option("--min-size", minSize, "Skip contours with fewer steps", true);
+  app.add_option("-e,--estimator", estimatorName, "Normal/curvature estimator", true)
+    ->check(CLI::IsMember(curveEstimatorNames()));
+  app.add_option("-s,--svg", svgFilename, "Export the contours as SVG");
+  app.add_option("-o,--output", outFilename, "Export per-point estimates (contour idx nx ny curv)");
+  CLI11_PARSE(app,argc,argv);
+  if ( nbThreads == 0 ) nbThreads = defaultNumberOfThreads();
+
+  //----------------------------------------------------------------------------
+  trace.beginBlock ( "Reading image" );
+  const bool isPBM = filename.size() > 4
+    && filename.substr( filename.size() - 4 ) == ".pbm";
+  Image image = isPBM ? importPBM( filename ) : GenericReader<Image>::import( filename );
+  const Point lower = image.domain().lowerBound();
+  const Point upper = image.domain().upperBound();
+  const int   w     = upper[ 0 ] - lower[ 0 ] + 1;
+  const int   hh    = upper[ 1 ] - lower[ 1 ] + 1;
+  std::vector<unsigned char> mask( std::size_t( w ) * hh );
+  parallelFor( hh, [&] ( std::size_t y )
+    {
+      for ( int x = 0; x < w; ++x )
+        mask[ y * w + x ] = image( lower + Point( x, (int) y ) ) > threshold;
+    }, nbThreads );
+  trace.info() << "Image " << w << "x" << hh << std::endl;
+  trace.endBlock();
+
+  //----------------------------------------------------------------------------
+  trace.beginBlock ( "Contour extraction" );
+  auto tstart = std::chrono::steady_clock::now();
+  KSpace kspace;
+  if (! kspace.init( lower, upper + Point::diagonal( 1 ), true ) )
+    throw std::runtime_error("Error in creating KSpace");
+  std::vector< std::vector<Point> > contours;
+  ContourExtraction2D extraction( mask, w, hh );
+  extraction.extract( contours,
+                      [&lower] ( int x, int y ) { return lower + Point( x, y ); },
+                      Curve::gridCurveInnerIsLeft( kspace ), nbThreads );
+  auto tcontours = std::chrono::steady_clock::now();
+  trace.info() << contours.size() << " contours" << std::endl;
+  trace.endBlock();
+
+  //----------------------------------------------------------------------------
+  trace.beginBlock ( "Contours -> normal/curvature/length" );
+  std::vector<ContourResult> results( contours.size() );
+  parallelFor( contours.size(), [&] ( std::size_t i )
+    {
+      if ( contours[ i ].size() < minSize ) return;
+      Curve curve( kspace );
+      curve.initFromVector( contours[ i ] );
+      estimate( estimatorName, curve, h, results[ i ] );
+    }, nbThreads );
+  auto tend = std::chrono::steady_clock::now();
+
+  std::size_t nbPoints = 0, nbEstimated = 0;
+  std::cout << "# contour size length total_curvature" << std::endl;
+  for ( std::size_t i = 0; i < results.size(); ++i ) {
+    if ( results[ i ].size == 0 ) continue;
+    nbPoints += results[ i ].size;
+    ++nbEstimated;
+    std::cout << i << " "
+	      << results[ i ].size << " "
+	      << results[ i ].length << " "
+	      << results[ i ].totalCurvature
+	      << std::endl;
+  }
+  const double extractionTime = std::chrono::duration<double>( tcontours - tstart ).count();
+  const double estimationTime = std::chrono::duration<double>( tend - tcontours ).count();
+  trace.info() << nbEstimated << " contours estimated ("
+               << nbPoints << " points) on " << nbThreads << " threads" << std::endl;
+  trace.info() << "Extraction time = " << extractionTime << " s" << std::endl;
+  trace.info() << "Estimation time = " << estimationTime << " s" << std::endl;
+  trace.info() << "Throughput = " << nbPoints / ( extractionTime + estimationTime )
+               << " points/s" << std::endl;
+  trace.endBlock();
+
+  //----------------------------------------------------------------------------
+  if ( ! outFilename.empty() ) {
+    std::ofstream out( outFilename.c_str() );
+    out << "# contour idx nx ny curv" << std::endl;
+    for ( std::size_t i = 0; i < results.size(); ++i )
+      for ( std::size_t j = 0; j < results[ i ].size; ++j )
+        out << i << " " << j << " "
+            << results[ i ].normals[ j ][ 0 ] << " "
+            << results[ i ].normals[ j ][ 1 ] << " "
+            << ( results[ i ].curvatures.empty() ? 0.0 : results[ i ].curvatures[ j ] )
+            << std::endl;
+  }
+  if ( ! svgFilename.empty() ) {
+    GridCurveSVGWriter<Point> writer( svgFilename, lower, upper + Point::diagonal( 1 ) );
+    for ( const auto& c : contours )
+      writer.addCurve( c.begin(), c.end() );
+  }
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,118 @@
+#include <iostream>
+#include <chrono>
+#include <random>
+
+#include "CLI11.hpp"
+
+#include "DGtal/base/Common.h"
+#include "DGtal/helpers/StdDefs.h"
+
+#include "DGtal/shapes/Shapes.h"
+#include "DGtal/shapes/ShapeFactory.h"
+#include "DGtal/shapes/GaussDigitizer.h"
+#include "DGtal/geometry/curves/GridCurve.h"
+
+#include "common/IncrementalCurveEstimator.h"
+
+using namespace DGtal;
+using namespace Z2i;
+
+typedef IncrementalCurveEstimator<KSpace> Estimator;
+
+//------------------------------------------------------------------------------
+template <typename TShape, typename TKSpace>
+void fillShapeBoundary( const TShape& aShape,
+			double aH,
+			TKSpace& aKSpace,
+			std::vector<typename TKSpace::Point>& aVector) {
+
+  GaussDigitizer<typename TKSpace::Space,TShape> dig;
+  dig.attach( aShape );
+  dig.init( aShape.getLowerBound(), aShape.getUpperBound(), aH );
+  // some room for the bumps
+  if (! aKSpace.init( dig.getLowerBound() - Point::diagonal( 8 ),
+                      dig.getUpperBound() + Point::diagonal( 8 ), true ) )
+    throw std::runtime_error("Error in creating KSpace");
+  SurfelAdjacency<TKSpace::dimension> sAdj( true );
+  typename TKSpace::SCell bel
+    = Surfaces<TKSpace>::findABel( aKSpace, dig, 10000 );
+  Surfaces<TKSpace>::track2DBoundaryPoints( aVector, aKSpace, sAdj, dig, bel );
+}
+
+//------------------------------------------------------------------------------
+/// Finds a place where the curve is straight over three steps, and
+/// inserts a one-pixel bump (or dent) there.
+bool bump( Estimator& estimator, std::mt19937& gen )
+{
+  const auto& P = estimator.points();
+  const std::size_t n = P.size();
+  std::uniform_int_distribution<std::size_t> dist( 1, n - 4 );
+  for ( int trial = 0; trial < 100; ++trial ) {
+    const std::size_t i = dist( gen );
+    const Vector d = P[ i + 1 ] - P[ i ];
+    if ( P[ i + 2 ] - P[ i + 1 ] != d || P[ i + 3 ] - P[ i + 2 ] != d ) continue;
+    const Vector o = ( gen() % 2 ) ? Vector( -d[ 1 ], d[ 0 ] ) : Vector( d[ 1 ], -d[ 0 ] );
+    std::vector<Point> newPoints;
+    newPoints.push_back( P[ i + 1 ] + o );
+    newPoints.push_back( P[ i + 2 ] + o );
+    estimator.replace( i + 2, i + 2, newPoints );
+    return true;
+  }
+  return false;
+}
+
+//------------------------------------------------------------------------------
+int main( int argc, char** argv )
+{
+  CLI::App app{"Incremental normal/curvature re-estimation after local edits"};
+  double h = 0.01;
+  unsigned int nbEdits = 100;
+  app.add_option("--gridstep", h, "Grid step", true);
+  app.add_option("-n,--edits", nbEdits, "Number of local edits", true);
+  CLI11_PARSE(app,argc,argv);
+
+  trace.beginBlock ( "Digitization" );
+  Flower2D<Space> shape( 0.5, 0.5, 5.0, 3.0, 5, 0.3 );
+  KSpace kspace;
+  std::vector<Point> points;
+  fillShapeBoundary( shape, h, kspace, points );
+  trace.info() << points.size() << " points" << std::endl;
+  trace.endBlock();
+
+  trace.beginBlock ( "Full estimation" );
+  Estimator estimator( kspace, h );
+  auto t0 = std::chrono::steady_clock::now();
+  estimator.init( points );
+  auto t1 = std::chrono::steady_clock::now();
+  const double fullTime = std::chrono::duration<double, std::milli>( t1 - t0 ).count();
+  trace.info() << "Time = " << fullTime << " ms" << std::endl;
+  trace.endBlock();
+
+  trace.beginBlock ( "Local edits" );
+  std::mt19937 gen( 0 );
+  unsigned int done = 0;
+  auto t2 = std::chrono::steady_clock::now();
+  for ( unsigned int e = 0; e < nbEdits; ++e )
+    done += bump( estimator, gen ) ? 1 : 0;
+  auto t3 = std::chrono::steady_clock::now();
+  const double editTime = std::chrono::duration<double, std::milli>( t3 - t2 ).count();
+  trace.info() << done << " edits, " << editTime / std::max( done, 1u )
+               << " ms per edit (full estimation: " << fullTime << " ms)" << std::endl;
+  trace.endBlock();
+
+  trace.beginBlock ( "Check against a full estimation" );
+  Estimator reference( kspace, h );
+  reference.init( estimator.points() );
+  double maxCurvatureDiff = 0.0, maxNormalDiff = 0.0;
+  for ( std::size_t i = 0; i < reference.size(); ++i ) {
+    maxCurvatureDiff = std::max( maxCurvatureDiff,
+                                 std::abs( reference.curvatures()[ i ] - estimator.curvatures()[ i ] ) );
+    maxNormalDiff    = std::max( maxNormalDiff,
+                                 ( reference.normals()[ i ] - estimator.normals()[ i ] ).norm() );
+  }
+  trace.info() << "Max curvature difference = " << maxCurvatureDiff << std::endl;
+  trace.info() << "Max normal difference = " << maxNormalDiff << std::endl;
+  trace.endBlock();
+
+  return ( maxCurvatureDiff == 0.0 && maxNormalDiff == 0.0 ) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -6,10 +6,10 @@
 #include "DGtal/shapes/GaussDigitizer.h"
 #include "DGtal/geometry/curves/GridCurve.h"
 #include "DGtal/io/boards/Board2D.h"
+#include "common/GridCurveSVGWriter.h"
 
-//normal/curvature
-#include "DGtal/geometry/curves/estimation/MostCenteredMaximalSegmentEstimator.h"
-#include "DGtal/geometry/curves/StabbingCircleComputer.h"
+//normal/curvature (estimators selected at compile time)
+#include "common/CurveEstimators2D.h"
 
 using namespace DGtal;
 
@@ -37,25 +37,6 @@ void fillShapeBoundary( const TShape& aShape,
   Surfaces<TKSpace>::track2DBoundaryPoints( aVector, aKSpace, sAdj, dig, bel );
 }
 
-//------------------------------------------------------------------------------
-template <typename InputIterator, typename Functor, typename OutputIterator> 
-void getEstimates(const InputIterator& itb,
-		  const InputIterator& ite,
-		  const Functor& aF,
-		  OutputIterator out,
-		  const double& aH) {
-
-  // create a segment computer, i.e., a way of computing a geometric primitive
-  using SegmentComputer = StabbingCircleComputer<InputIterator>;
-  SegmentComputer sc;
-
-  // create an estimator from the segment computer and the functor
-  using Estimator = MostCenteredMaximalSegmentEstimator<SegmentComputer,Functor>;
-  Estimator estimator(sc, aF);
-  estimator.init( itb, ite ); 
-  estimator.eval( itb, ite, out, aH );
-}
-
 //------------------------------------------------------------------------------
 int main( int argc, char** argv )
 {
@@ -68,6 +49,12 @@ int main( int argc, char** argv )
   double h = 0.1; 
   if (argc >= 2) h = std::atof(argv[1]);
   trace.info() << "Grid step = " << h << std::endl; 
+  // decimation tolerance of the SVG export (0 keeps every corner)
+  double tolerance = 0.0;
+  if (argc >= 3) tolerance = std::atof(argv[2]);
+  // normal/curvature estimator: dca, dss, lmst or bc
+  std::string estimatorName = DCAEstimator::name();
+  if (argc >= 4) estimatorName = argv[3];
 
   // shape
   Ellipse2D<Space> shape( 0.5, 0.5, 5.0, 3.0, 0.3 );
@@ -94,13 +81,22 @@ int main( int argc, char** argv )
     std::cerr << "GridCurve is expected to be closed" << std::endl;
     exit(EXIT_FAILURE); 
   }
-  // create a board
-  Board2D board;  
-  // draw the grid curve onto the board
-  board << SetMode( "PointVector", "Grid" )
-	<< gridcurve;
-  // save the drawing
-  board.saveSVG("gridcurve.svg");
+  // for small curves, a board is fine
+  if (gridcurve.size() < 10000) {
+    // create a board
+    Board2D board;  
+    // draw the grid curve onto the board
+    board << SetMode( "PointVector", "Grid" )
+	  << gridcurve;
+    // save the drawing
+    board.saveSVG("gridcurve.svg");
+  }
+  // for long curves, stream a single SVG path (nothing is kept in memory)
+  else {
+    auto pointsRange = gridcurve.getPointsRange();
+    saveGridCurveSVG( pointsRange.begin(), pointsRange.end(),
+		      "gridcurve.svg", 1.0, tolerance );
+  }
 
   trace.endBlock();
   
@@ -111,20 +107,15 @@ int main( int argc, char** argv )
   using Range = Curve::IncidentPointsRange;
   Range range = gridcurve.getIncidentPointsRange();
 
-  // we will use circulators because the gridcuve is closed
-  using Iterator = Range::ConstCirculator;
-  
-  // Curvature estimates 
+  // Normal and curvature estimates: the runtime choice dispatches to
+  // an instantiation of the chosen estimator
   std::vector<double> curvatures;
-  using CFunctor = CurvatureFromDCAEstimator<StabbingCircleComputer<Iterator>,false>;
-  CFunctor cf;
-  getEstimates(range.c(), range.c(), cf, std::back_inserter(curvatures), h);
-
-  // Normal estimates 
   std::vector<RealVector> normalVectors;
-  using NFunctor = NormalFromDCAEstimator<StabbingCircleComputer<Iterator> >;
-  NFunctor nf;
-  getEstimates(range.c(), range.c(), nf, std::back_inserter(normalVectors), h);
+  if (! estimateOnCurve(estimatorName, gridcurve, h, normalVectors, curvatures)) {
+    std::cerr << "Unknown estimator " << estimatorName << std::endl;
+    exit(EXIT_FAILURE);
+  }
+  trace.info() << "Estimator = " << estimatorName << std::endl;
 
   // Measure estimates
   std::vector<double> measures;
@@ -141,7 +132,7 @@ int main( int argc, char** argv )
     std::cout << i << " "
 	      << normalVectors[i][0] << " "
 	      << normalVectors[i][1] << " "
-	      << curvatures[i] << " "
+	      << ( curvatures.empty() ? 0.0 : curvatures[i] ) << " "
 	      << measures[i]
 	      << std::endl;
   }
@@ -155,6 +146,11 @@ int main( int argc, char** argv )
   //----------------------------------------------------------------------------
   trace.beginBlock ( "Integral of curvature" );
 
+  if (curvatures.empty()) {
+    trace.info() << "No curvature with estimator " << estimatorName << std::endl;
+    trace.endBlock();
+    return EXIT_SUCCESS;
+  }
   double totalCurvature = 0.0; 
   for ( int i = 0; i < n; i++ ) {
     totalCurvature += h*measures[i]*curvatures[i]; 
@@ -0,0 +1,132 @@
+#include <iostream>
+#include <sstream>
+#include <chrono>
+
+#include "CLI11.hpp"
+
+#include <DGtal/base/Common.h>
+#include <DGtal/helpers/StdDefs.h>
+#include <DGtal/helpers/Shortcuts.h>
+#include <DGtal/helpers/ShortcutsGeometry.h>
+
+#include "common/Parallel.h"
+#include "common/NarrowBandDigitizer.h"
+#include "common/ParallelVCM.h"
+
+using namespace DGtal;
+using namespace Z3i;
+
+// Using standard 3D digital space.
+typedef Shortcuts<KSpace>              SH3;
+typedef ShortcutsGeometry<KSpace>      SHG3;
+
+/// @return the names of the benchmarked normal estimators.
+std::vector<std::string> estimatorNames()
+{
+  return { "trivial", "ctrivial", "ii", "vcm", "vcm-grid" };
+}
+
+/// Normals of \a surfels given by the estimator called \a name.
+SH3::RealVectors estimateNormals( const std::string& name,
+                                  CountedPtr<SH3::BinaryImage> binary_image,
+                                  CountedPtr<SH3::DigitalSurface> surface,
+                                  const SH3::KSpace& K,
+                                  const SH3::SurfelRange& surfels,
+                                  const Parameters& params )
+{
+  if ( name == "trivial" )  return SHG3::getTrivialNormalVectors( K, surfels );
+  if ( name == "ctrivial" ) return SHG3::getCTrivialNormalVectors( surface, surfels, params );
+  if ( name == "ii" )       return SHG3::getIINormalVectors( binary_image, surfels, params );
+  if ( name == "vcm" )      return SHG3::getVCMNormalVectors( surface, surfels, params );
+  if ( name == "vcm-grid" ) return getParallelVCMNormalVectors( K, surfels, params, 1 );
+  throw std::invalid_argument( "Unknown estimator " + name );
+}
+
+/// Digitizes \a polynomial at gridstep \a h, runs every estimator and
+/// returns one line per estimator.
+std::string runCase( const std::string& polynomial, double h,
+                     const std::vector<std::string>& estimators,
+                     const std::string& digitization, Parameters params )
+{
+  params("surfaceComponents", "All")("verbose", 0);
+  params("polynomial", polynomial )
+    ("minAABB",-10.0)("maxAABB",10.0)("offset",1.0)
+    ("gridstep", h );
+  auto shape        = SH3::makeImplicitShape3D( params );
+  auto dshape       = SH3::makeDigitizedImplicitShape3D( shape, params );
+  auto K            = SH3::getKSpace( params );
+  auto binary_image =
+    digitization == "narrow-band" ? NarrowBandDigitizer( params ).makeBinaryImage( dshape ) :
+    digitization == "compiled"
+    ? NarrowBandDigitizer( params ).compiledPolynomial().makeBinaryImage( dshape, 1 )
+    : SH3::makeBinaryImage( dshape, params );
+  auto surface      = SH3::makeDigitalSurface( binary_image, K, params );
+  auto surfels      = SH3::getSurfelRange( surface, params );
+  auto true_normals = SHG3::getNormalVectors( shape, K, surfels, params );
+
+  std::ostringstream out;
+  for ( const auto& name : estimators )
+    {
+      auto start   = std::chrono::steady_clock::now();
+      auto normals = estimateNormals( name, binary_image, surface, K, surfels, params );
+      auto end     = std::chrono::steady_clock::now();
+      const double time = std::chrono::duration<double, std::milli>( end - start ).count();
+
+      // Loo and L2 (root mean square) angle errors
+      auto angle_diff = SHG3::getVectorsAngleDeviation( true_normals, normals );
+      double loo = 0.0, l2 = 0.0;
+      for ( auto a : angle_diff )
+        {
+          loo = std::max( loo, a );
+          l2 += a * a;
+        }
+      l2 = angle_diff.empty() ? 0.0 : sqrt( l2 / angle_diff.size() );
+      out << polynomial << " " << h << " " << name << " "
+          << surfels.size() << " " << time << " "
+          << loo << " " << l2 << std::endl;
+    }
+  return out.str();
+}
+
+int main( int argc, char** argv )
+{
+  CLI::App app{"Multigrid convergence of 3D normal estimators"};
+  std::vector<std::string> polynomials = { "sphere9", "torus", "goursat" };
+  std::vector<double>      gridsteps   = { 1.0, 0.5, 0.25 };
+  std::vector<std::string> estimators  = estimatorNames();
+  unsigned int nbThreads = 0;
+  double r = 3.0;
+  double R = 5.0;
+  std::string digitization = "narrow-band";
+  app.add_option("-p,--polynomials", polynomials, "Polynomials (predefined names or expressions)", true);
+  app.add_option("-g,--gridsteps", gridsteps, "Grid steps", true);
+  app.add_option("-e,--estimators", estimators, "Estimators", true)
+    ->check(CLI::IsMember(estimatorNames()));
+  app.add_option("-j,--threads", nbThreads, "Number of cases run at once (0 = all cores, 1 for accurate timings)", true);
+  app.add_option("-r,--r-radius", r, "Radius of II balls and of the VCM kernel", true);
+  app.add_option("-R,--R-radius", R, "Radius of the VCM offset", true);
+  app.add_option("-d,--digitization", digitization,
+                 "Polynomial evaluation: on every voxel ('full' or 'compiled') or only in a narrow band", true)
+    ->check(CLI::IsMember({ "full", "compiled", "narrow-band" }));
+  CLI11_PARSE(app,argc,argv);
+
+  auto params = SH3::defaultParameters() | SHG3::defaultParameters() |  SHG3::parametersGeometryEstimation();
+  params("r-radius", r)("R-radius", R);
+
+  // One case per (polynomial, gridstep), results printed in order.
+  std::vector< std::pair<std::string,double> > cases;
+  for ( const auto& p : polynomials )
+    for ( double h : gridsteps )
+      cases.push_back( std::make_pair( p, h ) );
+  std::vector<std::string> lines( cases.size() );
+
+  trace.beginBlock ( "Benchmark" );
+  std::cout << "# polynomial h estimator surfels time_ms loo_angle l2_angle" << std::endl;
+  parallelFor( cases.size(), [&] ( std::size_t i )
+    {
+      lines[ i ] = runCase( cases[ i ].first, cases[ i ].second, estimators, digitization, params );
+    }, nbThreads );
+  for ( const auto& l : lines ) std::cout << l;
+  trace.endBlock();
+  return EXIT_SUCCESS;
+}
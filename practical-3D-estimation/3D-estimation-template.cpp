@@ -7,6 +7,10 @@
 #include <polyscope/polyscope.h>
 #include <polyscope/surface_mesh.h>
 
+#include "common/QuadMesh.h"
+#include "common/AdaptiveDigitalSurface.h"
+#include "common/ManifoldCheck.h"
+
 
 using namespace DGtal;
 using namespace Z3i;
@@ -21,7 +25,7 @@ typedef SurfMesh::Index                Index;
 
 // Global variables to make easier GUI stuff.
 polyscope::SurfaceMesh *psMesh;
-SurfMesh surfmesh;
+QuadMesh<RealPoint>::Adjacency adjacency; // edges, faces of edges, neighbors of vertices
 float    GridStep = 0.5;
 
 /// Create an implicit shape \a polynomial digitized at gridstep \a h
@@ -38,29 +42,24 @@ void createShape( std::string polynomial, double h )
   auto dshape       = SH3::makeDigitizedImplicitShape3D( shape, params );
   auto K            = SH3::getKSpace( params );
   auto binary_image = SH3::makeBinaryImage( dshape, params );
-  auto surface      = SH3::makeDigitalSurface( binary_image, K, params );
-  auto primalSurface= SH3::makePrimalSurfaceMesh(surface);
-  auto surfels      = SH3::getSurfelRange( surface, params );
+  auto surface      = makeAdaptiveDigitalSurface( binary_image, K, params );
+  auto surfels      = surface.surfels();
   auto true_normals = SHG3::getNormalVectors( shape, K, surfels, params );
   
-  // Need to convert the faces
-  std::vector<std::vector<SH3::SurfaceMesh::Vertex>> faces;
-  std::vector<RealPoint> positions;
-  std::vector<RealPoint> smooth_positions;
-  
-  for(auto face= 0 ; face < primalSurface->nbFaces(); ++face)
-    faces.push_back(primalSurface->incidentVertices( face ));
-  
-  // Embed lattice points according to gridstep.
-  positions = primalSurface->positions();
-  for ( auto& x : positions ) x *= h;
-
-  // Create DGtal surface mesh object.
-  surfmesh = SurfMesh(positions.begin(), positions.end(),
-                      faces.begin(), faces.end());
-  std::cout << surfmesh << std::endl;
-  std::cout << "number of non-manifold Edges = "
-            << surfmesh.computeNonManifoldEdges().size() << std::endl;
+  // Quads in surfel order, lattice points embedded according to gridstep,
+  // and their adjacency (use mesh.makeSurfaceMesh() for the services of
+  // a DGtal SurfaceMesh).
+  QuadMesh<RealPoint> mesh;
+  mesh.init( K, surfels, h, &adjacency );
+  const auto& faces     = mesh.quads;
+  const auto& positions = mesh.positions;
+  std::cout << "[QuadMesh #V=" << mesh.nbVertices() << " #E=" << adjacency.nbEdges()
+            << " #F=" << mesh.nbFaces()
+            << " Chi=" << ( long( mesh.nbVertices() ) - long( adjacency.nbEdges() )
+                            + long( mesh.nbFaces() ) ) << "]" << std::endl;
+  const auto topology = checkManifoldness( mesh.quads, mesh.nbVertices() );
+  std::cout << "number of non-manifold Edges = " << topology.nonManifoldEdges.size()
+            << ", non-manifold Vertices = " << topology.nonManifoldVertices.size() << std::endl;
   // Create rendered polyscope surface.
   psMesh = polyscope::registerSurfaceMesh("digital surface", positions, faces);
   psMesh->addFaceVectorQuantity( "True normal vector field", true_normals );
@@ -0,0 +1,339 @@
+#include <iostream>
+#include <fstream>
+#include <chrono>
+#include <memory>
+#include <queue>
+#include <unordered_map>
+
+#include "CLI11.hpp"
+
+#include <DGtal/base/Common.h>
+#include <DGtal/helpers/StdDefs.h>
+#include <DGtal/helpers/Shortcuts.h>
+#include <DGtal/helpers/ShortcutsGeometry.h>
+
+#include "common/SurfelStream.h"
+#include "common/ParallelSurfelExtraction.h"
+#include "common/QuadMesh.h"
+#include "common/MergedQuadMesh.h"
+#include "common/ConnectedComponents.h"
+#include "common/NarrowBandDigitizer.h"
+#include "common/ParallelIntegralInvariant.h"
+
+using namespace DGtal;
+using namespace Z3i;
+
+// Using standard 3D digital space.
+typedef Shortcuts<KSpace>              SH3;
+typedef ShortcutsGeometry<KSpace>      SHG3;
+typedef SurfelStream<SH3::KSpace, SH3::BinaryImage> Stream;
+
+/// Writes the quads of chunks of surfels to an OBJ file as they come.
+/// Only the vertices of the last plane of pointels are remembered from
+/// one chunk to the next.
+struct OBJStreamWriter
+{
+  std::ofstream output;
+  double        h;
+  std::size_t   nbVertices = 0;
+  std::size_t   nbFaces    = 0; ///< one normal per face
+  std::unordered_map<std::uint64_t,std::size_t> indices;
+
+  OBJStreamWriter( const std::string& filename, double gridstep )
+    : output( filename.c_str() ), h( gridstep ) {}
+
+  void add( const SH3::KSpace& K, const SH3::SurfelRange& surfels,
+            const SH3::RealVectors& normals, int nextPlane )
+  {
+    for ( std::size_t f = 0; f < surfels.size(); ++f )
+      {
+        std::size_t idx[ 4 ];
+        const auto P = QuadMesh<RealPoint>::corners( K, surfels[ f ] );
+        for ( int v = 0; v < 4; ++v )
+          {
+            const auto key = QuadMesh<RealPoint>::key( P[ v ] );
+            auto it = indices.find( key );
+            if ( it == indices.end() )
+              {
+                const auto x = QuadMesh<RealPoint>::embed( P[ v ], h );
+                output << "v " << x[ 0 ] << " " << x[ 1 ] << " " << x[ 2 ] << "\n";
+                it = indices.insert( std::make_pair( key, ++nbVertices ) ).first;
+              }
+            idx[ v ] = it->second;
+          }
+        const auto& n = normals[ f ];
+        output << "vn " << n[ 0 ] << " " << n[ 1 ] << " " << n[ 2 ] << "\n";
+        output << "f";
+        for ( int v = 0; v < 4; ++v )
+          output << " " << idx[ v ] << "//" << ( nbFaces + f + 1 );
+        output << "\n";
+      }
+    nbFaces += surfels.size();
+    // Pointels below the next slab will not be seen again.
+    for ( auto it = indices.begin(); it != indices.end(); )
+      {
+        const int kz = int( it->first & 0x1fffff );
+        if ( ( kz & 0x100000 ? kz - 0x200000 : kz ) < 2 * nextPlane ) it = indices.erase( it );
+        else ++it;
+      }
+  }
+};
+
+/// Writes the quads of \a mesh (a QuadMesh or a MergedQuadMesh) and one
+/// normal per face to an OBJ file.
+template <typename TMesh>
+void writeOBJ( const std::string& filename, const TMesh& mesh,
+               const SH3::RealVectors& normals )
+{
+  std::ofstream output( filename.c_str() );
+  for ( const auto& x : mesh.positions )
+    output << "v " << x[ 0 ] << " " << x[ 1 ] << " " << x[ 2 ] << "\n";
+  for ( const auto& n : normals )
+    output << "vn " << n[ 0 ] << " " << n[ 1 ] << " " << n[ 2 ] << "\n";
+  for ( std::size_t f = 0; f < mesh.quads.size(); ++f )
+    {
+      output << "f";
+      for ( int v = 0; v < 4; ++v )
+        output << " " << ( mesh.quads[ f ][ v ] + 1 ) << "//" << ( f + 1 );
+      output << "\n";
+    }
+}
+
+/// Checks the voxel components \a C of \a image against a breadth-first
+/// labelling, one voxel at a time, of the voxels and of the outside.
+/// @param adjacency the foreground adjacency of \a C (6 or 18).
+/// @return the number of voxels whose component does not match (0 if
+/// both labellings are the same partition, with the same sizes).
+template <typename TImage>
+std::size_t checkComponents( const TImage& image, const ConnectedComponents& C,
+                             int adjacency )
+{
+  const std::size_t none = std::size_t( -1 );
+  const Point lo   = image.domain().lowerBound();
+  const Point hi   = image.domain().upperBound();
+  const Point size = hi - lo + Point::diagonal( 1 );
+  const std::size_t n = std::size_t( size[ 0 ] ) * size[ 1 ] * size[ 2 ];
+  auto index = [&] ( const Point& p )
+    {
+      return std::size_t( p[ 0 ] - lo[ 0 ] )
+        + size[ 0 ] * ( std::size_t( p[ 1 ] - lo[ 1 ] ) + size[ 1 ] * std::size_t( p[ 2 ] - lo[ 2 ] ) );
+    };
+  auto point = [&] ( std::size_t i )
+    {
+      return lo + Point( int( i % size[ 0 ] ), int( ( i / size[ 0 ] ) % size[ 1 ] ),
+                         int( i / ( size[ 0 ] * size[ 1 ] ) ) );
+    };
+  auto onBorder = [&] ( const Point& p )
+    {
+      for ( int k = 0; k < 3; ++k )
+        if ( p[ k ] == lo[ k ] || p[ k ] == hi[ k ] ) return true;
+      return false;
+    };
+  // Node n stands for the voxels outside the domain.
+  std::vector<std::size_t> label( n + 1, none );
+  std::vector<std::size_t> sizes;
+  std::queue<std::size_t>  Q;
+  for ( std::size_t s = 0; s <= n; ++s )
+    {
+      if ( label[ s ] != none ) continue;
+      const std::size_t c = sizes.size();
+      sizes.push_back( 0 );
+      label[ s ] = c;
+      Q.push( s );
+      while ( ! Q.empty() )
+        {
+          const std::size_t v = Q.front();
+          Q.pop();
+          if ( v == n )
+            {
+              for ( std::size_t t = 0; t < n; ++t )
+                if ( label[ t ] == none && ! image( point( t ) ) && onBorder( point( t ) ) )
+                  {
+                    label[ t ] = c;
+                    Q.push( t );
+                  }
+              continue;
+            }
+          sizes[ c ] += 1;
+          const Point p  = point( v );
+          const bool  fg = image( p );
+          const int   a  = fg ? adjacency : 24 - adjacency;
+          if ( ! fg && onBorder( p ) && label[ n ] == none )
+            {
+              label[ n ] = c;
+              Q.push( n );
+            }
+          for ( int dz = -1; dz <= 1; ++dz )
+            for ( int dy = -1; dy <= 1; ++dy )
+              for ( int dx = -1; dx <= 1; ++dx )
+                {
+                  const int nz = ( dx != 0 ) + ( dy != 0 ) + ( dz != 0 );
+                  if ( nz == 0 || nz == 3 || ( a == 6 && nz == 2 ) ) continue;
+                  const Point q = p + Point( dx, dy, dz );
+                  if ( ! image.domain().isInside( q ) ) continue;
+                  const std::size_t t = index( q );
+                  if ( label[ t ] == none && image( q ) == fg )
+                    {
+                      label[ t ] = c;
+                      Q.push( t );
+                    }
+                }
+        }
+    }
+  // Both labellings must correspond one to one, with equal sizes.
+  std::size_t nbErrors = sizes.size() == C.nbComponents() ? 0 : 1;
+  std::vector<std::size_t> toC( sizes.size(), none ), fromC( C.nbComponents(), none );
+  for ( std::size_t t = 0; t <= n; ++t )
+    {
+      const std::size_t b = label[ t ];
+      const std::size_t c = t == n ? C.outside() : C.label( point( t ) );
+      if ( c >= fromC.size() ) { ++nbErrors; continue; }
+      if ( toC[ b ] == none && fromC[ c ] == none ) { toC[ b ] = c; fromC[ c ] = b; }
+      if ( toC[ b ] != c || fromC[ c ] != b ) ++nbErrors;
+    }
+  for ( std::size_t b = 0; b < sizes.size(); ++b )
+    if ( toC[ b ] != none && C.components()[ toC[ b ] ].size != sizes[ b ] ) ++nbErrors;
+  return nbErrors;
+}
+
+int main( int argc, char** argv )
+{
+  CLI::App app{"Streams the surfels of a digital shape slab by slab"};
+  std::string filename;
+  std::string polynomial = "goursat";
+  std::string objFilename;
+  double h = 0.25;
+  int slab = 16;
+  bool ii  = false;
+  bool parallel = false;
+  bool merge    = false;
+  bool check    = false;
+  std::string components = "All";
+  unsigned int nbThreads = 0;
+  app.add_option("-i,--input", filename, "Input VOL file (instead of a polynomial)")->check(CLI::ExistingFile);
+  app.add_option("-p,--polynomial", polynomial, "Implicit polynomial (predefined name or expression)", true);
+  app.add_option("-g,--gridstep", h, "Grid step of the digitization", true);
+  app.add_option("-s,--slab", slab, "Number of voxel planes per chunk", true);
+  app.add_flag("--parallel", parallel, "Extract the whole surface at once, by slabs on several threads");
+  app.add_option("-j,--threads", nbThreads, "Number of threads with --parallel (0 = all cores)", true);
+  app.add_option("-c,--components", components, "With --parallel, keep all surface components or only the biggest one", true)
+    ->check(CLI::IsMember({ "All", "AnyBig" }));
+  app.add_flag("--merge", merge, "With --parallel, export coplanar surfels as maximal rectangles");
+  app.add_flag("--check-components", check, "Check the labelling of voxel components against a breadth-first search (slow)");
+  app.add_flag("--ii", ii, "Estimate normals by integral invariants (trivial normals otherwise)");
+  app.add_option("-o,--output", objFilename, "Export the surface and its normals as OBJ");
+  CLI11_PARSE(app,argc,argv);
+
+  auto params = SH3::defaultParameters() | SHG3::defaultParameters() |  SHG3::parametersGeometryEstimation();
+  params("verbose", 0);
+
+  trace.beginBlock ( "Binary image" );
+  CountedPtr<SH3::BinaryImage> binary_image;
+  if ( ! filename.empty() )
+    {
+      h = 1.0;
+      params("gridstep", h);
+      binary_image = SH3::makeBinaryImage( filename, params );
+    }
+  else
+    {
+      params("polynomial", polynomial )
+        ("minAABB",-10.0)("maxAABB",10.0)("offset",1.0)
+        ("gridstep", h );
+      auto shape   = SH3::makeImplicitShape3D( params );
+      auto dshape  = SH3::makeDigitizedImplicitShape3D( shape, params );
+      binary_image = NarrowBandDigitizer( params ).makeBinaryImage( dshape );
+    }
+  auto K = SH3::getKSpace( binary_image, params );
+  trace.endBlock();
+
+  if ( check )
+    {
+      trace.beginBlock ( "Checking voxel components" );
+      std::size_t nbErrors = 0;
+      for ( int adjacency : { 6, 18 } )
+        {
+          ConnectedComponents C( *binary_image, adjacency, nbThreads, slab );
+          const std::size_t errors = checkComponents( *binary_image, C, adjacency );
+          trace.info() << adjacency << "-connected foreground: " << C.nbComponents()
+                       << " components, " << errors << " errors" << std::endl;
+          nbErrors += errors;
+        }
+      trace.endBlock();
+      return nbErrors == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+
+  if ( parallel )
+    {
+      trace.beginBlock ( "Parallel extraction" );
+      auto start = std::chrono::steady_clock::now();
+      ParallelSurfelExtraction<SH3::KSpace, SH3::BinaryImage>
+        extraction( K, *binary_image, nbThreads, slab );
+      SH3::SurfelRange   surfels;
+      QuadMesh<RealPoint> mesh;
+      if ( components == "AnyBig" )
+        {
+          // Surface components from voxel components (6/18 for the
+          // default interior surfel adjacency).
+          surfels = extraction.surfels();
+          const int adjacency = params[ "surfelAdjacency" ].as<int>() == 0 ? 6 : 18;
+          ConnectedComponents C( *binary_image, adjacency, nbThreads );
+          const auto S = C.labelSurfels( K, surfels, nbThreads );
+          trace.info() << C.nbComponents() << " voxel components, "
+                       << S.components.size() << " surface components" << std::endl;
+          surfels = S.select( surfels, S.biggest() );
+          mesh.init( K, surfels, h );
+        }
+      else
+        extraction.quadMesh( surfels, mesh, h );
+      auto end = std::chrono::steady_clock::now();
+      trace.info() << surfels.size() << " surfels, " << mesh.positions.size()
+                   << " vertices, in " << extraction.nbSlabs() << " slabs" << std::endl;
+      trace.info() << "Time = " << std::chrono::duration<double>( end - start ).count()
+                   << " s" << std::endl;
+      if ( ! objFilename.empty() )
+        {
+          const auto normals = ii
+            ? parallelIINormalVectors( binary_image, surfels, params )
+            : SHG3::getTrivialNormalVectors( K, surfels );
+          if ( merge )
+            {
+              MergedQuadMesh<RealPoint> merged;
+              merged.init( K, surfels, h );
+              trace.info() << merged.nbFaces() << " rectangles, "
+                           << merged.nbVertices() << " vertices" << std::endl;
+              auto mnormals = merged.faceValues( normals );
+              for ( auto& n : mnormals ) n /= n.norm();
+              writeOBJ( objFilename, merged, mnormals );
+            }
+          else
+            writeOBJ( objFilename, mesh, normals );
+        }
+      trace.endBlock();
+      return EXIT_SUCCESS;
+    }
+
+  trace.beginBlock ( "Streaming surfels" );
+  std::unique_ptr<OBJStreamWriter> writer;
+  if ( ! objFilename.empty() ) writer.reset( new OBJStreamWriter( objFilename, h ) );
+  std::size_t nbSurfels = 0, maxChunk = 0;
+  auto start = std::chrono::steady_clock::now();
+  Stream stream( K, *binary_image, slab );
+  stream.forEachChunk( [&] ( const SH3::SurfelRange& chunk )
+    {
+      nbSurfels += chunk.size();
+      maxChunk   = std::max( maxChunk, chunk.size() );
+      if ( chunk.empty() ) return;
+      const auto normals = ii
+        ? parallelIINormalVectors( binary_image, chunk, params )
+        : SHG3::getTrivialNormalVectors( K, chunk );
+      if ( writer ) writer->add( K, chunk, normals, stream.currentPlane() );
+    } );
+  auto end = std::chrono::steady_clock::now();
+  trace.info() << nbSurfels << " surfels, at most " << maxChunk
+               << " per chunk" << std::endl;
+  trace.info() << "Time = " << std::chrono::duration<double>( end - start ).count()
+               << " s" << std::endl;
+  trace.endBlock();
+  return EXIT_SUCCESS;
+}
@@ -1,4 +1,7 @@
 #include <iostream>
+#include <memory>
+#include <chrono>
+#include <functional>
 #include <DGtal/base/Common.h>
 #include <DGtal/helpers/StdDefs.h>
 #include <DGtal/helpers/Shortcuts.h>
@@ -7,6 +10,19 @@
 #include <polyscope/polyscope.h>
 #include <polyscope/surface_mesh.h>
 
+#include "common/ParallelIntegralInvariant.h"
+#include "common/RunLengthIntegralInvariant.h"
+#include "common/ParallelVCM.h"
+#include "common/QuadMesh.h"
+#include "common/MergedQuadMesh.h"
+#include "common/AdaptiveDigitalSurface.h"
+#include "common/ManifoldCheck.h"
+#include "common/Parallel.h"
+#include "common/NarrowBandDigitizer.h"
+#include "common/ImplicitProjection.h"
+#include "common/BackgroundWorker.h"
+#include "common/FieldCache.h"
+
 
 using namespace DGtal;
 using namespace Z3i;
@@ -22,7 +38,6 @@ typedef SurfMesh::Index                Index;
 // Global variables to make easier GUI stuff.
 polyscope::SurfaceMesh *psMesh;
 polyscope::SurfaceMesh *psSmoothMesh;
-SurfMesh surfmesh;
 float    GridStep = 0.5;
 float    ErrorLoo = 0.0;
 float    ErrorL2  = 0.0;
@@ -32,130 +47,467 @@ double   Area1    = 0.0;
 double   EstArea0 = 0.0;
 double   EstArea1 = 0.0;
 double   Reach    = 9.0;
+double   EstimationTime = 0.0; // in ms
+ProjectionStatistics Projection;
+bool     UseDiskCache = true;
+bool     MergeQuads   = false; // display coplanar surfels as rectangles
+std::unique_ptr<FieldCache> DiskCache; // fields of previous sessions
+
+/// Results of the stages of computeShape. Each stage remembers the key it
+/// was computed for, and is recomputed only when this key or an upstream
+/// stage changes, so that e.g. switching estimators does not redigitize
+/// the shape.
+struct StageCache
+{
+  // Digitization stage, keyed by (polynomial, gridstep).
+  std::string                 polynomial;
+  double                      gridstep = -1.0;
+  CountedPtr<SH3::ImplicitShape3D> shape;
+  CompiledPolynomial3         compiled; // same polynomial as shape
+  SH3::KSpace                 K;
+  CountedPtr<SH3::BinaryImage> binary_image;
+  std::uint64_t               imageKey = 0; // hash of binary_image (0 until needed)
+  std::shared_ptr<RunLengthIntegralInvariant> runs; // built on demand
+  // Surface stage, keyed by the digitization.
+  bool                        hasSurface = false;
+  AdaptiveDigitalSurface      surface;
+  SH3::SurfelRange            surfels;
+  QuadMesh<RealPoint>         mesh;
+  std::shared_ptr<const MergedQuadMesh<RealPoint>> merged; // for display, built on demand
+  SH3::RealVectors            true_normals;
+  SH3::RealVectors            trivial_normals;
+  SH3::Scalars                all_K; // maximal absolute curvatures
+  double                      max_K = 0.0;
+  SH3::RealPoints             ppositions;
+  ProjectionStatistics        projection; // of ppositions, if computed
+  // Estimation stage, keyed by (estimator, surface).
+  int                         estimator = -1;
+  SH3::RealVectors            normals;
+  SH3::Scalars                est_K; // estimated maximal absolute curvatures (II-runs only)
+  double                      estimationTime = 0.0; // in ms
+};
+StageCache Cache;
+
+/// @return the hash of the digitized image, computed on the first use of
+/// the disk cache since it reads every voxel. Cached fields are per
+/// surfel, in the order of AdaptiveDigitalSurface::surfels(), which is
+/// part of the key.
+std::uint64_t cachedImageKey()
+{
+  if ( Cache.imageKey == 0 )
+    Cache.imageKey = FieldCache::Key().addImage( *Cache.binary_image )
+      .add( "surfels in scan order" ).value();
+  return Cache.imageKey;
+}
+
+/// @return the convolved trivial normals of \a surfels, in the container
+/// of \a surface.
+SH3::RealVectors getCTrivialNormalVectors( const AdaptiveDigitalSurface& surface,
+                                           const SH3::SurfelRange& surfels,
+                                           const Parameters& params )
+{
+  return surface.container == AdaptiveDigitalSurface::Light
+    ? SHG3::getCTrivialNormalVectors( surface.lightSurface, surfels, params )
+    : SHG3::getCTrivialNormalVectors( surface.explicitSurface, surfels, params );
+}
 
-/// Create an implicit shape \a polynomial digitized at gridstep \a h
+/// Per-face errors and global aggregates of the estimated normals.
+struct FaceMetrics
+{
+  SH3::Scalars angle_diff; ///< angle between true and estimated normals
+  SH3::Scalars M;          ///< 2: manifold, 1: neither manifold nor bijective, 0: otherwise
+  double errorLoo = 0.0, errorL2 = 0.0;
+  double area0 = 0.0, area1 = 0.0, estArea0 = 0.0, estArea1 = 0.0;
+};
+
+/// Computes the angle errors and their statistics, the areas (Euler
+/// integration) and the manifoldness/bijectivity in a single parallel
+/// sweep over the faces. Partial sums are kept per chunk and added in
+/// order, so that results do not depend on the number of threads.
+FaceMetrics computeFaceMetrics( const SH3::RealVectors& true_normals,
+                                const SH3::RealVectors& trivial_normals,
+                                const SH3::RealVectors& normals,
+                                double h, double reach )
+{
+  struct Partial
+  {
+    double sum = 0.0, sum2 = 0.0, max = 0.0;
+    double area0 = 0.0, area1 = 0.0, estArea0 = 0.0, estArea1 = 0.0;
+  };
+  const std::size_t n         = normals.size();
+  const std::size_t chunkSize = 4096;
+  const double manifold_angle = 1.260 * h / reach;
+  const double bijective_comp = 2.0 * sqrt( 3.0 ) * h / reach;
+  FaceMetrics F;
+  F.angle_diff.resize( n );
+  F.M.resize( n );
+  std::vector<Partial> partials( ( n + chunkSize - 1 ) / chunkSize );
+  parallelForChunks( n, chunkSize, [&] ( std::size_t b, std::size_t e, unsigned int )
+    {
+      Partial& P = partials[ b / chunkSize ];
+      for ( std::size_t i = b; i < e; ++i )
+        {
+          const auto& t = true_normals[ i ];
+          const auto& u = normals[ i ];
+          const auto& z = trivial_normals[ i ];
+          const double a = acos( std::max( -1.0, std::min( 1.0, t.dot( u ) ) ) );
+          F.angle_diff[ i ] = a;
+          P.sum  += a;
+          P.sum2 += a * a;
+          P.max   = std::max( P.max, a );
+          P.area0    += z.dot( t );
+          P.estArea0 += z.dot( u );
+          P.area1    += 1.0 / ( fabs( t[ 0 ] ) + fabs( t[ 1 ] ) + fabs( t[ 2 ] ) );
+          P.estArea1 += 1.0 / ( fabs( u[ 0 ] ) + fabs( u[ 1 ] ) + fabs( u[ 2 ] ) );
+          const double tmax = std::max( fabs( t[ 0 ] ), std::max( fabs( t[ 1 ] ), fabs( t[ 2 ] ) ) );
+          const double tmin = std::min( fabs( t[ 0 ] ), std::min( fabs( t[ 1 ] ), fabs( t[ 2 ] ) ) );
+          const bool manifold  = acos( std::min( 1.0, tmax ) ) <= manifold_angle;
+          const bool bijective = tmin > bijective_comp;
+          F.M[ i ] = manifold ? 2.0 : ( bijective ? 0.0 : 1.0 );
+        }
+    } );
+  Partial T;
+  for ( const auto& P : partials )
+    {
+      T.sum  += P.sum;   T.sum2 += P.sum2;  T.max = std::max( T.max, P.max );
+      T.area0 += P.area0; T.area1 += P.area1;
+      T.estArea0 += P.estArea0; T.estArea1 += P.estArea1;
+    }
+  const double mean = n > 0 ? T.sum / n : 0.0;
+  F.errorLoo = T.max;
+  F.errorL2  = n > 0 ? sqrt( std::max( 0.0, T.sum2 / n - mean * mean ) ) : 0.0;
+  F.area0    = T.area0    * h * h;
+  F.area1    = T.area1    * h * h;
+  F.estArea0 = T.estArea0 * h * h;
+  F.estArea1 = T.estArea1 * h * h;
+  return F;
+}
+
+/// Everything the viewer needs from a computation.
+struct ShapeResult
+{
+  std::vector<QuadMesh<RealPoint>::Quad> faces;
+  std::vector<RealPoint> positions;
+  std::shared_ptr<const MergedQuadMesh<RealPoint>> merged; // if asked for
+  SH3::RealPoints        ppositions;
+  SH3::RealVectors       normals;
+  SH3::RealVectors       true_normals;
+  SH3::Scalars           all_K;
+  SH3::Scalars           est_K;
+  double                 max_K = 0.0;
+  double                 reach = 0.0;
+  double                 estimationTime = 0.0;
+  ProjectionStatistics   projection;
+  FaceMetrics            F;
+};
+
+typedef BackgroundWorker<ShapeResult> Worker;
+std::unique_ptr<Worker> TheWorker;
+
+/// Opens a trace block and closes it when leaving its scope, also when a
+/// stage throws (e.g. when its task is cancelled).
+struct TraceBlock
+{
+  explicit TraceBlock( const std::string& name ) { trace.beginBlock( name ); }
+  ~TraceBlock() { trace.endBlock(); }
+};
+
+/// Computes the implicit shape \a polynomial digitized at gridstep \a h
+/// and its normals by \a estimator. Runs on the worker thread, which is
+/// the only one to use the stage cache.
 /// @param polynomial the implicit function as a  multivariate polynomial string.
 /// @param h the chosen digitization gridstep
-void createShape( std::string polynomial, double h, double reach )
+/// @param estimator the chosen normal estimator
+/// @param useDiskCache when 'true', true and estimated fields are read
+/// from (or stored in) the on-disk cache.
+/// @param mergeQuads when 'true', the rectangles of coplanar surfels are
+/// built (once per surface) for display.
+/// @param token to report progress and check for cancellation between
+/// stages, their steps, and the chunks of their parallel loops.
+ShapeResult computeShape( std::string polynomial, double h, int estimator,
+                          bool useDiskCache, bool mergeQuads,
+                          const Worker::Token& token )
 {
   auto params = SH3::defaultParameters() | SHG3::defaultParameters() |  SHG3::parametersGeometryEstimation();
+  const std::function<void()> check = [&token] { token.check(); };
   params("surfaceComponents", "All");
   params("polynomial", polynomial )
     ("minAABB",-10.0)("maxAABB",10.0)("offset",1.0)
     ("gridstep", h );
-  Reach = reach;
-  auto shape        = SH3::makeImplicitShape3D( params );
-  auto dshape       = SH3::makeDigitizedImplicitShape3D( shape, params );
-  auto K            = SH3::getKSpace( params );
-  auto binary_image = SH3::makeBinaryImage( dshape, params );
-  auto surface      = SH3::makeDigitalSurface( binary_image, K, params );
-  auto primalSurface= SH3::makePrimalSurfaceMesh(surface);
-  auto surfels      = SH3::getSurfelRange( surface, params );
-  auto true_normals    = SHG3::getNormalVectors( shape, K, surfels, params );
-  auto trivial_normals = SHG3::getTrivialNormalVectors( K, surfels );
-  auto normals         =
-    Estimator == 0 ? trivial_normals :
-    Estimator == 1 ? SHG3::getCTrivialNormalVectors( surface, surfels, params )
-    : SHG3::getIINormalVectors( binary_image, surfels, params );
-  
-  // Need to convert the faces
-  std::vector<std::vector<SH3::SurfaceMesh::Vertex>> faces;
-  std::vector<RealPoint> positions;
-  std::vector<RealPoint> smooth_positions;
-  
-  for(auto face= 0 ; face < primalSurface->nbFaces(); ++face)
-    faces.push_back(primalSurface->incidentVertices( face ));
-  
-  // Embed lattice points according to gridstep.
-  positions = primalSurface->positions();
-  for ( auto& x : positions ) x *= h;
-
-  // Create DGtal surface mesh object.
-  surfmesh = SurfMesh(positions.begin(), positions.end(),
-                      faces.begin(), faces.end());
-  std::cout << surfmesh << std::endl;
-  std::cout << "number of non-manifold Edges = "
-            << surfmesh.computeNonManifoldEdges().size() << std::endl;
-
-  // Create rendered polyscope surface.
-  psMesh = polyscope::registerSurfaceMesh("digital surface", positions, faces);
-  psMesh->addFaceVectorQuantity( "Estimated normal vector field", normals );
-  psMesh->addFaceVectorQuantity( "True normal vector field", true_normals );
-
-  // Compute errors
-  auto angle_diff  = SHG3::getVectorsAngleDeviation( true_normals, normals );
-  auto stat_angles = SHG3::getStatistic( angle_diff );
-  ErrorLoo = stat_angles.max();
-  ErrorL2  = sqrt( stat_angles.variance() );
-
-  // View errors
-  psMesh->addFaceScalarQuantity( "Angle error", angle_diff )
-    ->setMapRange( { 0.0, M_PI / 20.0 } ) // 10° is bad !
-    ->setColorMap( "coolwarm" );
-
-  // Compute area (method Euler integration)
-  Area0    = 0.0;
-  Area1    = 0.0;
-  EstArea0 = 0.0;
-  EstArea1 = 0.0;
-  auto L1  = normals[ 0 ].L_1;
-  for ( Face i = 0; i < surfmesh.nbFaces(); i++ )
+  if ( polynomial != Cache.polynomial || h != Cache.gridstep )
     {
-      Area0    += trivial_normals[ i ].dot( true_normals[ i ] );
-      EstArea0 += trivial_normals[ i ].dot( normals[ i ] );
-      Area1    += 1.0 / true_normals[ i ].norm( L1 );
-      EstArea1 += 1.0 / normals[ i ].norm( L1 );
+      token.progress( "Digitization", 0.0 );
+      TraceBlock block( "Digitization" );
+      // Invalidates this stage and the next ones until they succeed, so
+      // that an exception does not leave them keyed by the previous shape.
+      Cache.polynomial.clear();
+      Cache.gridstep   = -1.0;
+      Cache.hasSurface = false;
+      Cache.estimator  = -1;
+      Cache.shape        = SH3::makeImplicitShape3D( params );
+      auto dshape        = SH3::makeDigitizedImplicitShape3D( Cache.shape, params );
+      Cache.K            = SH3::getKSpace( params );
+      // Evaluates the polynomial only near the surface.
+      NarrowBandDigitizer digitizer( params );
+      Cache.binary_image = digitizer.makeBinaryImage( dshape, check );
+      Cache.compiled     = digitizer.compiledPolynomial();
+      trace.info() << digitizer.nbEvaluations() << " voxels evaluated, "
+                   << digitizer.nbFilledBoxes() << " boxes filled" << std::endl;
+      Cache.imageKey     = 0;
+      Cache.runs.reset();
+      Cache.polynomial   = polynomial;
+      Cache.gridstep     = h;
+      Cache.hasSurface   = false;
     }
-  Area0    *= GridStep * GridStep;
-  Area1    *= GridStep * GridStep;
-  EstArea0 *= GridStep * GridStep;
-  EstArea1 *= GridStep * GridStep;
-
-
-  // Create smooth surface
-  auto ppositions = SHG3::getPositions( shape, positions, params );
-  psSmoothMesh    = polyscope::registerSurfaceMesh("smooth surface", ppositions, faces);
-  
-  // Compute curvatures and estimate reach.
-  auto curvatures = SHG3::getPrincipalCurvaturesAndDirections( shape, K, surfels, params );
-  auto all_K      = angle_diff; // will store the maximal curvatures
-  double max_K    = 0.0; 
-  for ( Face i = 0; i < surfmesh.nbFaces(); i++ )  
+  if ( ! Cache.hasSurface )
     {
-      const double k1 = std::get<0>( curvatures[ i ] );
-      const double k2 = std::get<1>( curvatures[ i ] );
-      all_K[ i ] = std::max( fabs( k1 ), fabs( k2 ) );
-      max_K      = std::max( max_K, all_K[ i ] );
+      token.progress( "Surface and true geometry", 0.3 );
+      TraceBlock block( "Surface and true geometry" );
+      Cache.estimator  = -1;
+      Cache.surface      = makeAdaptiveDigitalSurface( Cache.binary_image, Cache.K, params );
+      Cache.surfels      = Cache.surface.surfels();
+      // Quads in surfel order, lattice points embedded according to gridstep.
+      Cache.mesh.init( Cache.K, Cache.surfels, h );
+      Cache.merged.reset();
+      Cache.trivial_normals = SHG3::getTrivialNormalVectors( Cache.K, Cache.surfels );
+      token.check();
+      const auto key = ! useDiskCache ? 0
+        : FieldCache::Key().add( std::int64_t( cachedImageKey() ) )
+        .add( "true geometry" ).add( polynomial ).add( h ).value();
+      auto entry = useDiskCache ? DiskCache->find( key ) : nullptr;
+      if ( entry && entry->field( "true_normals" ).size == Cache.surfels.size()
+           && entry->field( "ppositions" ).size == Cache.mesh.positions.size()
+           && entry->field( "all_K" ).size == Cache.surfels.size()
+           && entry->field( "max_K" ).size == 1 )
+        {
+          trace.info() << "True geometry read from " << DiskCache->path( key ) << std::endl;
+          Cache.true_normals = entry->vectors<SH3::RealVectors>( "true_normals" );
+          Cache.ppositions   = entry->vectors<SH3::RealPoints>( "ppositions" );
+          Cache.all_K        = entry->scalars( "all_K" );
+          Cache.max_K        = entry->scalars( "max_K" )[ 0 ];
+          Cache.projection   = ProjectionStatistics();
+        }
+      else
+        {
+          Cache.true_normals = SHG3::getNormalVectors( Cache.shape, Cache.K, Cache.surfels, params );
+          token.check();
+          const auto curvatures = SHG3::getPrincipalCurvaturesAndDirections( Cache.shape, Cache.K, Cache.surfels, params );
+          Cache.all_K.resize( curvatures.size() );
+          Cache.max_K = 0.0;
+          for ( std::size_t i = 0; i < curvatures.size(); i++ )
+            {
+              const double k1 = std::get<0>( curvatures[ i ] );
+              const double k2 = std::get<1>( curvatures[ i ] );
+              Cache.all_K[ i ] = std::max( fabs( k1 ), fabs( k2 ) );
+              Cache.max_K      = std::max( Cache.max_K, Cache.all_K[ i ] );
+            }
+          token.check();
+          Cache.ppositions = projectOnImplicitSurface( Cache.compiled, Cache.mesh.positions,
+                                                       params, &Cache.projection, 0, check );
+          trace.info() << "Projection: " << Cache.projection.nbConverged << "/"
+                       << Cache.projection.nbPoints << " converged in "
+                       << Cache.projection.time << " ms" << std::endl;
+          if ( useDiskCache )
+            DiskCache->store( key, FieldCache::Fields()
+                              .addVectors( "true_normals", Cache.true_normals )
+                              .addVectors( "ppositions", Cache.ppositions )
+                              .addScalars( "all_K", Cache.all_K )
+                              .addScalars( "max_K", { Cache.max_K } ) );
+        }
+
+      // Mesh statistics, without building a DGtal SurfaceMesh.
+      const auto topology = checkManifoldness( Cache.mesh.quads, Cache.mesh.nbVertices() );
+      std::cout << "[QuadMesh #V=" << Cache.mesh.nbVertices()
+                << " #E=" << topology.nbEdges << " #F=" << Cache.mesh.nbFaces()
+                << " Chi=" << ( long( Cache.mesh.nbVertices() ) - long( topology.nbEdges )
+                                + long( Cache.mesh.nbFaces() ) ) << "]" << std::endl;
+      std::cout << "number of non-manifold Edges = " << topology.nonManifoldEdges.size()
+                << ", non-manifold Vertices = " << topology.nonManifoldVertices.size() << std::endl;
+      Cache.hasSurface = true;
     }
-  psSmoothMesh->addFaceScalarQuantity( "Max curvatures", all_K )
-    ->setMapRange( { 0.0, max_K } ) 
-    ->setColorMap( "coolwarm" );
-  // Estimate reach
-  Reach = 1.0 / max_K;
-  
-  // Compute manifoldness
-  auto M = angle_diff;
-  auto Loo = true_normals[ 0 ].L_infty;
-  for ( Face i = 0; i < surfmesh.nbFaces(); i++ )
+  if ( estimator != Cache.estimator )
     {
-      double a = acos( std::min( 1.0, true_normals[ i ].norm( Loo ) ) );
-      M[ i ] = a > ( 1.260 * GridStep / Reach ) ? 0.0 : 2.0;
+      token.progress( "Normal estimation", 0.6 );
+      TraceBlock block( "Normal estimation" );
+      Cache.estimator = -1;
+      auto start = std::chrono::steady_clock::now();
+      const auto key = ! useDiskCache ? 0
+        : FieldCache::Key().add( std::int64_t( cachedImageKey() ) )
+        .add( "normals" ).add( std::int64_t( estimator ) )
+        .add( params[ "r-radius" ].as<double>() ).add( params[ "R-radius" ].as<double>() )
+        .add( h ).value();
+      // Trivial normals are cheaper to compute than to read.
+      auto entry = useDiskCache && estimator != 0 ? DiskCache->find( key ) : nullptr;
+      if ( entry && entry->field( "normals" ).size == Cache.surfels.size() )
+        {
+          trace.info() << "Normals read from " << DiskCache->path( key ) << std::endl;
+          Cache.normals = entry->vectors<SH3::RealVectors>( "normals" );
+          Cache.est_K   = entry->scalars( "est_K" );
+        }
+      else
+        {
+          Cache.est_K.clear();
+          if ( estimator == 3 )
+            {
+              // Normals and curvatures from the same balls.
+              if ( ! Cache.runs )
+                Cache.runs = std::make_shared<RunLengthIntegralInvariant>( *Cache.binary_image );
+              const auto G = getRunLengthIIGeometry( *Cache.runs, Cache.K, Cache.surfels, params );
+              Cache.normals.resize( G.size() );
+              Cache.est_K.resize( G.size() );
+              for ( std::size_t i = 0; i < G.size(); ++i )
+                {
+                  Cache.normals[ i ] = G[ i ].normal;
+                  Cache.est_K[ i ]   = std::max( fabs( G[ i ].k1 ), fabs( G[ i ].k2 ) );
+                }
+            }
+          else
+            Cache.normals =
+              estimator == 0 ? Cache.trivial_normals :
+              estimator == 1 ? getCTrivialNormalVectors( Cache.surface, Cache.surfels, params ) :
+              estimator == 2 ? parallelIINormalVectors( Cache.binary_image, Cache.surfels, params, 0, check )
+              : getParallelVCMNormalVectors( Cache.K, Cache.surfels, params );
+          if ( useDiskCache && estimator != 0 )
+            DiskCache->store( key, FieldCache::Fields()
+                              .addVectors( "normals", Cache.normals )
+                              .addScalars( "est_K", Cache.est_K ) );
+        }
+      auto end = std::chrono::steady_clock::now();
+      Cache.estimationTime = std::chrono::duration<double, std::milli>( end - start ).count();
+      Cache.estimator = estimator;
     }
-  // Compute bijectiveness
-  for ( Face i = 0; i < surfmesh.nbFaces(); i++ )
+  if ( mergeQuads && ! Cache.merged )
     {
-      auto   n = true_normals[ i ];
-      auto   c = std::min( fabs( n[ 0 ] ), std::min( fabs( n[ 1 ] ), fabs( n[ 2 ] ) ) );
-      bool   b = c > ( 2.0 * sqrt( 3.0 ) * GridStep / Reach );
-      if ( ( ! b ) && ( M[ i ] < 0.5 ) ) M[ i ] = 1.0;
+      auto merged = std::make_shared<MergedQuadMesh<RealPoint>>();
+      merged->init( Cache.K, Cache.surfels, h );
+      std::cout << "[Merged #V=" << merged->nbVertices()
+                << " #F=" << merged->nbFaces() << "]" << std::endl;
+      Cache.merged = merged;
     }
-  psMesh->addFaceScalarQuantity( "Manifoldness / Bijectivity", M );
-  psSmoothMesh->addFaceScalarQuantity( "Manifoldness / Bijectivity", M );
+  token.progress( "Errors and areas", 0.9 );
+  ShapeResult R;
+  R.faces        = Cache.mesh.quads;
+  R.positions    = Cache.mesh.positions;
+  R.merged       = mergeQuads ? Cache.merged : nullptr;
+  R.ppositions   = Cache.ppositions;
+  R.normals      = Cache.normals;
+  R.true_normals = Cache.true_normals;
+  R.all_K        = Cache.all_K;
+  R.est_K        = Cache.est_K;
+  R.max_K        = Cache.max_K;
+  R.estimationTime = Cache.estimationTime;
+  R.projection     = Cache.projection;
+
+  // Estimate reach from curvatures.
+  R.reach = 1.0 / Cache.max_K;
+
+  // Compute errors, areas and manifoldness in one sweep.
+  R.F = computeFaceMetrics( Cache.true_normals, Cache.trivial_normals, Cache.normals,
+                            h, R.reach );
+  return R;
+}
+
+ShapeResult Shown; // last shape swapped into the viewer
+std::string LastPolynomial; // last shape submitted
+double      LastGridStep = 0.5;
+
+/// @return 'true' if \a R is displayed with rectangles of coplanar surfels.
+bool displaysMerged( const ShapeResult& R )
+{
+  return MergeQuads && R.merged;
+}
+
+/// @return the per-face quantity \a values of \a R as displayed, i.e.
+/// averaged over rectangles if they are displayed.
+template <typename TValue>
+std::vector<TValue> displayed( const ShapeResult& R, const std::vector<TValue>& values )
+{
+  return displaysMerged( R ) ? R.merged->faceValues( values ) : values;
+}
+
+/// @return the per-face normals \a normals of \a R as displayed, i.e.
+/// averaged and renormalized over rectangles if they are displayed.
+SH3::RealVectors displayedNormals( const ShapeResult& R, const SH3::RealVectors& normals )
+{
+  auto result = displayed( R, normals );
+  if ( displaysMerged( R ) )
+    for ( auto& n : result ) n /= n.norm();
+  return result;
+}
+
+/// Swaps a computed shape into the viewer (GUI thread).
+void showShape( const ShapeResult& R )
+{
+  const auto& F = R.F;
+  Reach    = R.reach;
+  EstimationTime = R.estimationTime;
+  Projection     = R.projection;
+  ErrorLoo = F.errorLoo;
+  ErrorL2  = F.errorL2;
+  Area0    = F.area0;
+  Area1    = F.area1;
+  EstArea0 = F.estArea0;
+  EstArea1 = F.estArea1;
+
+  // Create rendered polyscope surface, with one face per rectangle of
+  // coplanar surfels if MergeQuads is set.
+  psMesh = displaysMerged( R )
+    ? polyscope::registerSurfaceMesh("digital surface", R.merged->positions, R.merged->quads)
+    : polyscope::registerSurfaceMesh("digital surface", R.positions, R.faces);
+  psMesh->addFaceVectorQuantity( "Estimated normal vector field", displayedNormals( R, R.normals ) );
+  psMesh->addFaceVectorQuantity( "True normal vector field", displayedNormals( R, R.true_normals ) );
+
+  // View errors
+  psMesh->addFaceScalarQuantity( "Angle error", displayed( R, F.angle_diff ) )
+    ->setMapRange( { 0.0, M_PI / 20.0 } ) // 10° is bad !
+    ->setColorMap( "coolwarm" );
+
+  // Create smooth surface
+  psSmoothMesh    = polyscope::registerSurfaceMesh("smooth surface", R.ppositions, R.faces);
+  psSmoothMesh->addFaceScalarQuantity( "Max curvatures", R.all_K )
+    ->setMapRange( { 0.0, R.max_K } ) 
+    ->setColorMap( "coolwarm" );
+  // A rectangle is shown manifold (2) only if all its surfels are.
+  psMesh->addFaceScalarQuantity( "Manifoldness / Bijectivity",
+                                 displaysMerged( R ) ? R.merged->faceMin( F.M ) : F.M );
+  psSmoothMesh->addFaceScalarQuantity( "Manifoldness / Bijectivity", F.M );
+  if ( ! R.est_K.empty() )
+    psMesh->addFaceScalarQuantity( "Estimated max curvatures", displayed( R, R.est_K ) )
+      ->setMapRange( { 0.0, R.max_K } )
+      ->setColorMap( "coolwarm" );
+}
+
+/// Create an implicit shape \a polynomial digitized at gridstep \a h, in
+/// the background. A new call supersedes the running one.
+/// @param polynomial the implicit function as a  multivariate polynomial string.
+/// @param h the chosen digitization gridstep
+void createShape( std::string polynomial, double h, double reach )
+{
+  Reach = reach;
+  LastPolynomial = polynomial;
+  LastGridStep   = h;
+  const int  estimator    = Estimator;
+  const bool useDiskCache = UseDiskCache;
+  const bool mergeQuads   = MergeQuads;
+  TheWorker->submit( [=] ( const Worker::Token& token )
+                     { return computeShape( polynomial, h, estimator, useDiskCache,
+                                            mergeQuads, token ); } );
 }
 
 /// Defines the GUI buttons and reactions.
 void myCallback()
 {
+  ShapeResult result;
+  if ( TheWorker->take( result ) )
+    {
+      std::swap( Shown, result );
+      showShape( Shown );
+    }
+  if ( TheWorker->busy() )
+    ImGui::Text( "Computing: %s (%d%%)", TheWorker->stage().c_str(),
+                 int( 100.0 * TheWorker->progress() ) );
+  else if ( ! TheWorker->error().empty() )
+    ImGui::Text( "Error: %s", TheWorker->error().c_str() );
   if(ImGui::Button("Sphere")) createShape( "sphere9", GridStep, 9.0 );
   ImGui::SameLine();
   if(ImGui::Button("Torus")) createShape( "torus", GridStep, 2.0 );
@@ -167,12 +519,31 @@ void myCallback()
   ImGui::SameLine();
   if(ImGui::Button("Cylinder")) createShape( "x^2-2*x*y+y^2+z^2-25", GridStep, 5.0 );
   ImGui::Text( "Reach is at most %f", Reach );
+  if ( Projection.nbPoints > 0 )
+    ImGui::Text( "Projection: %d/%d converged, %.1f steps on average (max %d), max |f|=%g, %.1f ms",
+                 int( Projection.nbConverged ), int( Projection.nbPoints ),
+                 double( Projection.nbIterations ) / Projection.nbPoints,
+                 int( Projection.maxIterations ), Projection.maxResidual, Projection.time );
   ImGui::SliderFloat("Gridstep h parameter", &GridStep, 0.025, 2.0);
   ImGui::Text( "Normal estimator: " );          ImGui::SameLine();
   ImGui::RadioButton("Trivial",  &Estimator, 0); ImGui::SameLine();
   ImGui::RadioButton("CTrivial", &Estimator, 1); ImGui::SameLine();
-  ImGui::RadioButton("II",       &Estimator, 2);
-  ImGui::Text( "Normal error loo=%f   l2=%f", ErrorLoo, ErrorL2 );
+  ImGui::RadioButton("II",       &Estimator, 2); ImGui::SameLine();
+  ImGui::RadioButton("II-runs",  &Estimator, 3); ImGui::SameLine();
+  ImGui::RadioButton("VCM",      &Estimator, 4);
+  ImGui::Checkbox("Reuse fields of previous sessions (disk cache)", &UseDiskCache);
+  if ( ImGui::Checkbox("Merge coplanar quads for display", &MergeQuads) && ! Shown.faces.empty() )
+    {
+      // The rectangles are only built when asked for: the last shape is
+      // then recomputed, which only builds them, the other stages being
+      // cached.
+      if ( MergeQuads && ! Shown.merged )
+        createShape( LastPolynomial, LastGridStep, Reach );
+      else
+        showShape( Shown );
+    }
+  ImGui::Text( "Normal error loo=%f   l2=%f   (estimated in %.1f ms)",
+               ErrorLoo, ErrorL2, EstimationTime );
   // If you wish to compare with the exact phere9 true area:
   // double target_area = 4.0 * M_PI * 9.0 * 9.0;
   ImGui::Text( "Expected area0=%f area1=%f", Area0, Area1 );
@@ -195,6 +566,8 @@ int main()
 
   // Initialize polyscope
   polyscope::init();
+  TheWorker.reset( new Worker );
+  DiskCache.reset( new FieldCache( "3D-estimation-cache" ) );
 
   // Create shape
   createShape( "sphere9", GridStep, 9.0 );
@@ -18,6 +18,9 @@
 #include "polyscope/point_cloud.h"
 #include "polyscope/surface_mesh.h"
 
+#include "common/QuadMesh.h"
+#include "common/AdaptiveDigitalSurface.h"
+
 
 using namespace DGtal;
 using namespace Z3i;
@@ -40,22 +43,14 @@ void registerDigitalSurface( CountedPtr< SH3::BinaryImage > bimage,
   auto h=1.; //gridstep
   params( "closed", 1)("surfaceComponents", "AnyBig");
   auto K             = SH3::getKSpace( bimage );
-  auto surface       = SH3::makeDigitalSurface( bimage, K, params );
-  auto primalSurface = SH3::makePrimalSurfaceMesh(surface);
+  // Outer boundary of the biggest component, in the cheaper container.
+  auto surface       = makeAdaptiveDigitalSurface( bimage, K, params );
+  auto surfels       = surface.surfels();
   
-  std::vector<std::vector<size_t>> faces;
-  std::vector<RealPoint> positions;
-  //Need to convert the faces
-  for(size_t face= 0 ; face < primalSurface->nbFaces(); ++face)
-    faces.push_back(primalSurface->incidentVertices( face ));
-  //Recasting to vector of vertices
-  positions = primalSurface->positions();
-  auto surfmesh = SurfMesh(positions.begin(),
-                           positions.end(),
-                           faces.begin(),
-                           faces.end());
+  QuadMesh<RealPoint> mesh;
+  mesh.init( K, surfels, h );
   
-  auto primalSurf = polyscope::registerSurfaceMesh( name, positions, faces);
+  auto primalSurf = polyscope::registerSurfaceMesh( name, mesh.positions, mesh.quads );
 }
 
 // Removes a peel of simple points onto voxel object.
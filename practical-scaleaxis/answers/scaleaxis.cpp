@@ -22,6 +22,8 @@
 
 #include "CLI11.hpp"
 
+#include "common/QuadMesh.h"
+
 
 using namespace DGtal;
 using namespace Z3i;
@@ -162,20 +164,13 @@ int main(int argc, char **argv)
   binary_image = SH3::makeBinaryImage(filename, params );
   auto K            = SH3::getKSpace( binary_image );
   auto surface      = SH3::makeDigitalSurface( binary_image, K, params );
-  auto primalSurface = SH3::makePrimalSurfaceMesh(surface);
+  auto surfels       = SH3::getSurfelRange( surface, params );
   
   //For the visualization of the digital surface.
-  std::vector<std::vector<size_t>> faces;
-  std::vector<RealPoint> positions;
-  for(size_t face= 0 ; face < primalSurface->nbFaces(); ++face)
-    faces.push_back(primalSurface->incidentVertices( face ));
-  positions = primalSurface->positions();
-  auto surfmesh = SurfMesh(positions.begin(),
-                           positions.end(),
-                           faces.begin(),
-                           faces.end());
-  
-  polyscope::registerSurfaceMesh("Digital surface", positions, faces);
+  QuadMesh<RealPoint> mesh;
+  mesh.init( K, surfels );
+  
+  polyscope::registerSurfaceMesh("Digital surface", mesh.positions, mesh.quads);
   
   
   polyscope::state::userCallback = myCallback;